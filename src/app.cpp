@@ -1,9 +1,10 @@
 #include "app.hpp"
 
-#include <algorithm> // std::find_if.
-#include <cstring> // std::memcpy.
+#include <algorithm> // std::ranges::sort, std::ranges::lower_bound, std::unique.
+#include <cstring> // std::memcpy, std::memcmp.
 
-#include "ghuva/utils/list.hpp"
+#include "ghuva/utils/trace.hpp"
+#include "ghuva/utils/hash.hpp"
 #include "ghuva/utils.hpp"
 #include "ghuva/mesh.hpp"
 
@@ -15,16 +16,22 @@
 using namespace ghuva::aliases;
 namespace cvt = ghuva::cvt;
 
+namespace
+{
+    // Bitwise, anything that'd upload something different counts.
+    static_assert(sizeof(ghuva::transform) == 9 * sizeof(f32));
+    auto same(ghuva::transform const& a, ghuva::transform const& b) -> bool { return std::memcmp(&a, &b, sizeof(a)) == 0; }
+
+    // Dirty instances closer than this get uploaded (and converted) together, the clean
+    // ones in between along with them. Cheaper than another copy and dispatch.
+    constexpr auto instance_gap = 16_u64;
+}
+
 app::app()
     : ctx{ ghuva::context::get() }
 {}
 
-app::~app()
-{
-    if(scene.geometry_buffer.data != nullptr) delete scene.geometry_buffer.data;
-    if(scene.instance_buffer.data != nullptr) delete scene.instance_buffer.data;
-    if(scene.index_buffer.data    != nullptr) delete scene.index_buffer.data;
-}
+app::~app() = default;
 
 auto app::init() -> void
 {
@@ -59,6 +66,7 @@ auto app::loop(void* original_userdata, loop_callback user_callback) -> void
 
 auto app::loop_impl(f32 dt) -> ghuva::context::loop_message
 {
+    GHUVA_TRACE_ZONE("app::loop");
     if(ui.w != ctx.w || ui.h != ctx.h) ctx.set_resolution(ui.w, ui.h);
 
     sync_params_to_outputs();
@@ -77,10 +85,13 @@ auto app::sync_params_to_outputs() -> void
     outputs.target_tps              = params.engine.tps;
     outputs.target_time_multiplier  = params.engine.time_multiplier;
     outputs.parallel_ticking        = params.engine.parallel_ticking;
+    outputs.job_pool                = params.engine.job_pool;
+    outputs.tick_workers            = params.engine.tick_workers;
 }
 
 auto app::write_scene_uniform() -> void
 {
+    GHUVA_TRACE_ZONE("app::write_scene_uniform");
     // Then updating the uniform buffers.
     ui.scene_uniforms = {
         .view = ghuva::m4f::from_parts(params.camera.t.pos, params.camera.t.rot, params.camera.t.scale),
@@ -97,158 +108,480 @@ auto app::write_scene_uniform() -> void
         .time  = params.engine.total_time,
         .gamma = 2.2,
     };
-    ctx.device.getQueue().writeBuffer(ctx.scene_uniform_buffer, 0, &ui.scene_uniforms, sizeof(ui.scene_uniforms));
+    auto const staged = ctx.stage(sizeof(ui.scene_uniforms));
+    std::memcpy(staged.data, &ui.scene_uniforms, sizeof(ui.scene_uniforms));
+    ctx.copy_staged(staged, ctx.scene_uniform_buffer, 0, sizeof(ui.scene_uniforms));
 }
 
 auto app::build_scene_geometry() -> void
 {
-    if(params.meshes == nullptr || params.mesh_count == 0_u64) return;
+    GHUVA_TRACE_ZONE("app::build_scene_geometry");
+    if(params.meshes_generation != scene.meshes_generation || scene.compact_requested)
+    {
+        sync_scene_meshes(scene.compact_requested);
+        regroup_instances();
+    }
+    scene.compact_requested = false;
+    scene.dirty_instances.clear();
 
-    scene.geometry_offsets.clear();
-    scene.geometry_offsets.reserve(params.mesh_count);
+    // Then the instances. Only what changed gets looked at when the objects do, in between
+    // ticks only the moving ones do, and when neither happened there's nothing to do.
+    if(compute_pass != scene.instances_computed) // Everything has to go again.
+    {
+        scene.instances_computed = compute_pass;
+        scene.uploaded_instances = 0;
+        for(auto i = 0_u64; i < scene.instance_count; ++i) scene.touched_instances.push_back(i);
+    }
+    if(params.objects_generation != scene.objects_generation) sync_instances();
+    else if(params.interpolation_alpha != scene.instances_alpha)
+        scene.touched_instances.insert(scene.touched_instances.end(), scene.moving_instances.begin(), scene.moving_instances.end());
 
-    // Prepare for instancing.
-    std::sort(
-        params.meshes,
-        params.meshes + params.mesh_count,
-        [](auto a, auto b){ return a.id < b.id; }
-    ); // Sort by id ASC.
+    if(!scene.touched_instances.empty()) refresh_instances();
+}
 
-    // Build the geometry_offsets first so we can do the buffer allocation all at once using the sizes found.
-    auto curr_idx    = 0_u64;
-    auto curr_vertex = 0_u64;
-    for(auto i = 0_u64; i < params.mesh_count; ++i)
+auto app::sync_instances() -> void
+{
+    GHUVA_TRACE_ZONE("app::sync_instances");
+    scene.objects_generation = params.objects_generation;
+
+    // Whatever was moving is done with it, unless it moves again below.
+    for(auto const i : scene.moving_instances)
     {
-        auto& mesh = params.meshes[i];
+        scene.instance_previous_t[i] = scene.instance_t[i];
+        scene.touched_instances.push_back(i);
+    }
+    scene.moving_instances.clear();
 
-        scene.geometry_offsets.push_back({
-            .id = mesh.id,
-            .instance_count = 0,
-            .start_index = curr_idx,
-            .index_count = mesh.indexes.size(),
-            .start_vertex = curr_vertex,
-        });
+    // What's on the GPU stays put, so scene.instances still tells what doesn't need uploading.
+    if(params.objects_reset)
+    {
+        scene.instance_ids.clear();
+        scene.instance_mesh_ids.clear();
+        scene.instance_t.clear();
+        scene.instance_previous_t.clear();
+        scene.instance_slots.clear();
+        std::ranges::fill(scene.instance_group_ends, 0_u64);
+    }
+
+    for(auto k = 0_u64; k < params.deleted_count; ++k)
+        if(auto const it = scene.instance_slots.find(params.deleted_objects[k]); it != scene.instance_slots.end())
+            erase_instance(it->second);
 
-        curr_idx    += mesh.indexes.size();
-        curr_vertex += mesh.vertexes.size() / 3;
+    for(auto k = 0_u64; k < params.object_count; ++k)
+    {
+        auto const& obj = params.objects[k];
+        auto const  it  = scene.instance_slots.find(obj.id);
+        if(it == scene.instance_slots.end()) { insert_instance(obj); continue; }
+
+        auto const slot = it->second;
+        if(scene.instance_mesh_ids[slot] != obj.mesh_id) { erase_instance(slot); insert_instance(obj); continue; }
+
+        scene.instance_t[slot]          = obj.t;
+        scene.instance_previous_t[slot] = obj.previous_t;
+        scene.touched_instances.push_back(slot);
     }
 
-    scene.index_buffer = ghuva::list<ghuva::context::index_t>
-        ::from_container( ghuva::move(scene.index_buffer) )
-        .reserve_nocopy(curr_idx)
-        .override_size(curr_idx)
-        .surrender();
-
-    auto const vertex_count = curr_vertex * 3; // * 3 since each buffer has 3 elements per vertex
-                                               // (pos has x,y,z; color has r,g,b; normal has nx,ny,nz).
-    auto const geometry_buf_size = vertex_count * 3; // * 3 since there are 3 buffers (position, color, normals).
-    scene.geometry_buffer = ghuva::list<ghuva::context::vertex_t>
-        ::from_container( ghuva::move(scene.geometry_buffer) )
-        .reserve_nocopy(geometry_buf_size)
-        .override_size(geometry_buf_size)
-        .surrender();
-
-    // Copy all the mesh data into our buffers.
-    auto const position_start = scene.geometry_buffer.data;
-    auto const color_start    = position_start + scene.geometry_buffer.size / 3;
-    auto const normal_start   = color_start    + scene.geometry_buffer.size / 3;
-    auto const index_start    = scene.index_buffer.data;
-
-    auto vertex_offset = 0_u64;
-    auto index_offset  = 0_u64;
-    for(auto i = 0_u64; i < params.mesh_count; ++i)
+    // Only now that everything has settled in its slot.
+    for(auto k = 0_u64; k < params.object_count; ++k)
     {
-        auto const& mesh = params.meshes[i];
+        auto const& obj = params.objects[k];
+        if(!same(obj.previous_t, obj.t)) scene.moving_instances.push_back(scene.instance_slots[obj.id]);
+    }
+    std::ranges::sort(scene.moving_instances);
+    scene.moving_instances.erase(std::unique(scene.moving_instances.begin(), scene.moving_instances.end()), scene.moving_instances.end());
+
+    count_instances();
+}
+
+// When the meshes change their groups might too, counting sort the instances into the new
+// ones. Those that end up where they were don't count as touched.
+auto app::regroup_instances() -> void
+{
+    GHUVA_TRACE_ZONE("app::regroup_instances");
+    auto const groups = scene.geometry_offsets.size() + 1;
+    auto const count  = scene.instance_ids.size();
+
+    auto group_of = std::vector<u64>(count);
+    auto next     = std::vector<u64>(groups, 0); // Where the next instance of each group goes.
+    for(auto i = 0_u64; i < count; ++i)
+    {
+        group_of[i] = instance_group(scene.instance_mesh_ids[i]);
+        ++next[group_of[i]];
+    }
+    scene.instance_group_ends.resize(groups);
+    for(auto g = 0_u64, end = 0_u64; g < groups; ++g)
+    {
+        auto const size = next[g];
+        next[g] = end;
+        end += size;
+        scene.instance_group_ends[g] = end;
+    }
+
+    auto moved_to = std::vector<u64>(count);
+    auto moved    = false;
+    for(auto i = 0_u64; i < count; ++i)
+    {
+        moved_to[i] = next[group_of[i]]++;
+        moved |= moved_to[i] != i;
+    }
+
+    if(moved)
+    {
+        auto const permute = [&](auto& v){
+            auto out = std::remove_cvref_t<decltype(v)>(v.size());
+            for(auto i = 0_u64; i < count; ++i) out[moved_to[i]] = v[i];
+            v = ghuva::move(out);
+        };
+        permute(scene.instance_ids);
+        permute(scene.instance_mesh_ids);
+        permute(scene.instance_t);
+        permute(scene.instance_previous_t);
+
+        for(auto i = 0_u64; i < count; ++i)
+        {
+            if(moved_to[i] == i) continue;
+            scene.instance_slots[scene.instance_ids[moved_to[i]]] = moved_to[i];
+            scene.touched_instances.push_back(moved_to[i]);
+        }
+        for(auto& i : scene.moving_instances) i = moved_to[i];
+        std::ranges::sort(scene.moving_instances);
+    }
+
+    count_instances();
+}
+
+// At the end of its group, making room by moving the first instance of every group after it
+// to the end of that same group.
+auto app::insert_instance(object const& obj) -> void
+{
+    auto slot = scene.instance_ids.size();
+    scene.instance_ids.push_back(obj.id);
+    scene.instance_mesh_ids.push_back(obj.mesh_id);
+    scene.instance_t.push_back(obj.t);
+    scene.instance_previous_t.push_back(obj.previous_t);
+    scene.instance_slots[obj.id] = slot;
+    scene.touched_instances.push_back(slot);
+
+    auto& ends = scene.instance_group_ends;
+    auto const group = instance_group(obj.mesh_id);
+    for(auto g = ends.size() - 1; g > group; --g)
+    {
+        auto const first = ends[g - 1];
+        swap_instances(first, slot);
+        slot = first;
+        ++ends[g];
+    }
+    ++ends[group];
+}
+
+// The other way around, the hole left behind is filled by the last instance of its group and
+// so on until it reaches the end.
+auto app::erase_instance(u64 slot) -> void
+{
+    auto& ends = scene.instance_group_ends;
+    for(auto g = (std::ranges::upper_bound(ends, slot) - ends.begin()) * cvt::to<u64>; g < ends.size(); ++g)
+    {
+        auto const last = --ends[g];
+        swap_instances(slot, last);
+        slot = last;
+    }
+
+    scene.instance_slots.erase(scene.instance_ids.back());
+    scene.instance_ids.pop_back();
+    scene.instance_mesh_ids.pop_back();
+    scene.instance_t.pop_back();
+    scene.instance_previous_t.pop_back();
+}
+
+// Only the objects trade places, what's on the GPU (and scene.instances) stays where it was.
+auto app::swap_instances(u64 a, u64 b) -> void
+{
+    if(a == b) return;
+    std::swap(scene.instance_ids[a],        scene.instance_ids[b]);
+    std::swap(scene.instance_mesh_ids[a],   scene.instance_mesh_ids[b]);
+    std::swap(scene.instance_t[a],          scene.instance_t[b]);
+    std::swap(scene.instance_previous_t[a], scene.instance_previous_t[b]);
+    scene.instance_slots[scene.instance_ids[a]] = a;
+    scene.instance_slots[scene.instance_ids[b]] = b;
+    scene.touched_instances.push_back(a);
+    scene.touched_instances.push_back(b);
+}
+
+// Index of the mesh in geometry_offsets, or past them when it isn't there.
+auto app::instance_group(u64 mesh_id) const -> u64
+{
+    auto const& meshes = scene.geometry_offsets;
+    auto const  it     = std::ranges::lower_bound(meshes, mesh_id, {}, &decltype(scene)::mesh_data::id);
+    if(it == meshes.end() || it->id != mesh_id) return meshes.size();
+    return (it - meshes.begin()) * cvt::to<u64>;
+}
+
+auto app::count_instances() -> void
+{
+    auto const& ends = scene.instance_group_ends;
+    for(auto g = 0_u64; g < scene.geometry_offsets.size(); ++g)
+        scene.geometry_offsets[g].instance_count = ends[g] - (g == 0 ? 0 : ends[g - 1]);
+    scene.instance_count = scene.instance_ids.size();
+}
+
+// Blends the touched instances and uploads the ones that don't match what's on the GPU.
+auto app::refresh_instances() -> void
+{
+    GHUVA_TRACE_ZONE("app::refresh_instances");
+    scene.instances_alpha = params.interpolation_alpha;
+
+    auto& touched = scene.touched_instances;
+    std::ranges::sort(touched);
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    auto const count = scene.instance_count;
+    if(count != 0) ctx.reserve_objects(count);
+    if(scene.instances.size() < count) scene.instances.resize(count);
+
+    for(auto const i : touched)
+    {
+        if(i >= count) break; // Gone since, nothing to draw there.
+        auto const t = ghuva::lerp(scene.instance_previous_t[i], scene.instance_t[i], scene.instances_alpha);
+        if(i < scene.uploaded_instances && same(scene.instances[i], t)) continue;
+
+        scene.instances[i] = t;
+        mark_instance_dirty(i);
+    }
+    touched.clear();
+    scene.uploaded_instances = std::max(scene.uploaded_instances, count);
 
-        auto const vertex_bsize = mesh.vertexes.size() * sizeof(ghuva::context::vertex_t);
-        auto const index_bsize  = mesh.indexes.size()  * sizeof(ghuva::context::index_t);
+    upload_dirty_instances();
+}
+
+// Has to be called in order, coalesces as it goes.
+auto app::mark_instance_dirty(u64 i) -> void
+{
+    auto const limit = ctx.object_chunk_limit;
+    if(!scene.dirty_instances.empty())
+    {
+        auto& last = scene.dirty_instances.back();
+        if(i < last.first + last.count + instance_gap && i / limit == last.first / limit)
+        {
+            last.count = i + 1 - last.first;
+            return;
+        }
+    }
+    scene.dirty_instances.push_back({ .first = i, .count = 1 });
+}
 
-        std::memcpy(position_start + vertex_offset, mesh.vertexes.data(), vertex_bsize);
-        std::memcpy(color_start    + vertex_offset, mesh.colors.data(),   vertex_bsize);
-        std::memcpy(normal_start   + vertex_offset, mesh.normals.data(),  vertex_bsize);
-        std::memcpy(index_start    + index_offset,  mesh.indexes.data(),  index_bsize);
+// Written straight into staging memory from scene.instances, a copy per dirty range.
+auto app::upload_dirty_instances() -> void
+{
+    if(scene.dirty_instances.empty()) return;
+    auto const limit = ctx.object_chunk_limit;
 
-        vertex_offset += mesh.vertexes.size();
-        index_offset  += mesh.indexes.size();
+    // The compute pass takes a dispatch per range and only has room for so many of them,
+    // past that each chunk goes over from its first dirty instance to its last.
+    if(scene.dirty_instances.size() > ctx.max_compute_ranges)
+    {
+        auto merged = decltype(scene.dirty_instances){};
+        for(auto const& r : scene.dirty_instances)
+        {
+            if(!merged.empty() && merged.back().first / limit == r.first / limit) merged.back().count = r.first + r.count - merged.back().first;
+            else merged.push_back(r);
+        }
+        scene.dirty_instances = ghuva::move(merged);
     }
 
-    // And finally, build our instancing buffer.
-    if(params.object_count == 0) return;
+    for(auto const& r : scene.dirty_instances)
+    {
+        auto const bytes  = r.count * sizeof(ghuva::context::object_uniforms);
+        auto const staged = ctx.stage(bytes);
+        ctx.copy_staged(staged, ctx.object_chunks[r.first / limit].buffer, r.first % limit * sizeof(ghuva::context::object_uniforms), bytes);
 
-    scene.instance_buffer = ghuva::list<ghuva::context::object_uniforms>
-        ::from_container( ghuva::move(scene.instance_buffer) )
-        .reserve_nocopy(params.object_count)
-        .override_size(params.object_count)
-        .surrender();
+        auto* const out = staged.data * cvt::rc<ghuva::context::object_uniforms*>;
+        for(auto i = 0_u64; i < r.count; ++i)
+        {
+            auto const& t = scene.instances[r.first + i];
+            if(compute_pass)
+            {
+                new (out + i) ghuva::context::compute_object_uniforms{
+                    .pos   = {t.pos.x,   t.pos.y,   t.pos.z},
+                    .rot   = {t.rot.x,   t.rot.y,   t.rot.z},
+                    .scale = {t.scale.x, t.scale.y, t.scale.z},
+                };
+            }
+            else
+            {
+                new (out + i) ghuva::context::object_uniforms{ ghuva::m4f::from_parts(
+                    t.pos,
+                    t.rot,
+                    t.scale
+                )};
+            }
+        }
+    }
 
+    // And where each dispatch of the compute pass starts, see compute_transform_matrix_via_compute_pass().
+    if(!compute_pass) return;
+    auto const stride = ctx.compute_range_stride;
+    auto const bytes  = scene.dirty_instances.size() * stride;
+    auto const staged = ctx.stage(bytes);
+    ctx.copy_staged(staged, ctx.compute_range_buffer, 0, bytes);
+    for(auto k = 0_u64; k < scene.dirty_instances.size(); ++k)
+    {
+        auto const& r = scene.dirty_instances[k];
+        new (static_cast<std::byte*>(staged.data) + k * stride) ghuva::context::compute_range{
+            .first = (r.first % limit) * cvt::to<u32>,
+            .count = r.count * cvt::to<u32>,
+        };
+    }
+}
+
+// Every mesh gets a slot in the GPU buffers that it keeps for as long as it's around, so
+// only new (or changed) meshes get uploaded and dropping one leaves the others alone. When
+// the holes left behind keep a new mesh from fitting, or when asked to, everything gets
+// packed back together and uploaded again.
+auto app::sync_scene_meshes(bool compact) -> void
+{
+    GHUVA_TRACE_ZONE("app::sync_scene_meshes");
+    scene.meshes_generation = params.meshes_generation;
+    scene.pending_uploads.clear();
+
+    auto const mesh_count = params.meshes == nullptr ? 0_u64 : params.mesh_count;
     std::sort(
-        params.objects,
-        params.objects + params.object_count,
-        [](auto a, auto b){ return a.mesh_id < b.mesh_id; }
-    ); // Sort by mesh_id ASC.
-
-    auto last_mesh_id    = params.objects[0].mesh_id;
-    auto last_mesh_index = 0_u64;
-    for(auto i = 0_u64; i < params.object_count; ++i)
+        params.meshes,
+        params.meshes + mesh_count,
+        [](auto const& a, auto const& b){ return a.id < b.id; }
+    ); // Sort by id ASC.
+
+    // Only the meshes we haven't seen get hashed, unless ids might have been reused.
+    auto hashes = std::vector<u64>(mesh_count);
+    auto index_of = std::unordered_map<u64, u64>{}; // Mesh id -> index in params.meshes.
+    for(auto i = 0_u64; i < mesh_count; ++i)
     {
-        auto& obj = params.objects[i];
-        if(obj.mesh_id != last_mesh_id) ++last_mesh_index;
+        auto const& mesh = params.meshes[i];
+        index_of[mesh.id] = i;
 
-        ++scene.geometry_offsets[last_mesh_index].instance_count;
+        auto const slot = scene.mesh_slots.find(mesh.id);
+        if(!params.meshes_reset && slot != scene.mesh_slots.end()) { hashes[i] = slot->second.hash; continue; }
 
-        auto const offset = scene.instance_buffer.data + i;
-        if(compute_pass)
+        auto h = ghuva::fnv1a(std::span(mesh.vertexes));
+        h = ghuva::fnv1a(std::span(mesh.colors),  h);
+        h = ghuva::fnv1a(std::span(mesh.normals), h);
+        hashes[i] = ghuva::fnv1a(std::span(mesh.indexes), h);
+    }
+
+    // Free the slots of the meshes that are gone or changed.
+    if(compact || scene.vertex_allocator.capacity() == 0)
+    {
+        scene.vertex_allocator.reset(ctx.vertex_capacity);
+        scene.index_allocator.reset(ctx.index_capacity);
+        scene.mesh_slots.clear();
+    }
+    std::erase_if(scene.mesh_slots, [&](auto const& pair){
+        auto const& [id, slot] = pair;
+        auto const it = index_of.find(id);
+        if(it != index_of.end() && hashes[it->second] == slot.hash) return false;
+
+        scene.vertex_allocator.free(slot.vertexes);
+        scene.index_allocator.free(slot.indexes);
+        return true;
+    });
+
+    // Then find some for the ones that don't have one.
+    auto const vertex_count = [](ghuva::mesh const& mesh){ return mesh.vertexes.size() / 3; };
+    auto const index_count  = [](ghuva::mesh const& mesh){ return (mesh.indexes.size() + 1) / 2 * 2; };
+    auto const place = [&](u64 i){
+        auto const& mesh    = params.meshes[i];
+        auto const vertexes = scene.vertex_allocator.allocate(vertex_count(mesh));
+        auto const indexes  = scene.index_allocator.allocate(index_count(mesh), 2);
+        if(vertexes && indexes)
         {
-            new (offset) ghuva::context::compute_object_uniforms{
-                .pos   = {obj.t.pos.x,   obj.t.pos.y,   obj.t.pos.z},
-                .rot   = {obj.t.rot.x,   obj.t.rot.y,   obj.t.rot.z},
-                .scale = {obj.t.scale.x, obj.t.scale.y, obj.t.scale.z},
-            };
+            scene.mesh_slots[mesh.id] = { .vertexes = *vertexes, .indexes = *indexes, .hash = hashes[i] };
+            scene.pending_uploads.push_back(i);
+            return true;
         }
-        else
+
+        if(vertexes) scene.vertex_allocator.free(*vertexes);
+        if(indexes)  scene.index_allocator.free(*indexes);
+        return false;
+    };
+    for(auto i = 0_u64; i < mesh_count; ++i)
+    {
+        if(scene.mesh_slots.contains(params.meshes[i].id) || place(i)) continue;
+
+        auto const& mesh = params.meshes[i];
+        if(!compact && (scene.vertex_allocator.fragmented(vertex_count(mesh)) || scene.index_allocator.fragmented(index_count(mesh))))
+            return sync_scene_meshes(true);
+
+        // Out of room altogether, grow the buffers enough to fit it at the end.
+        if(ctx.reserve_vertexes(scene.vertex_allocator.end() + vertex_count(mesh)) && ctx.reserve_indexes(scene.index_allocator.end() + index_count(mesh)))
         {
-            new (offset) ghuva::context::object_uniforms{ ghuva::m4f::from_parts(
-                obj.t.pos,
-                obj.t.rot,
-                obj.t.scale
-            )};
+            scene.vertex_allocator.grow(ctx.vertex_capacity);
+            scene.index_allocator.grow(ctx.index_capacity);
+            if(place(i)) continue;
         }
 
-        last_mesh_id = obj.mesh_id;
+        fmt::print("[app] No room for mesh {} ({} vertexes, {} indexes), it won't be drawn\n", mesh.id, vertex_count(mesh), mesh.indexes.size());
     }
+
+    scene.geometry_offsets.clear();
+    scene.geometry_offsets.reserve(mesh_count);
+    for(auto i = 0_u64; i < mesh_count; ++i)
+    {
+        auto const& mesh = params.meshes[i];
+        auto const  it   = scene.mesh_slots.find(mesh.id);
+        auto const  has  = it != scene.mesh_slots.end();
+
+        scene.geometry_offsets.push_back({
+            .id = mesh.id,
+            .instance_count = 0,
+            .start_index = has ? it->second.indexes.offset : 0,
+            .index_count = has ? mesh.indexes.size() : 0, // Draws nothing without a slot.
+            .start_vertex = has ? it->second.vertexes.offset : 0,
+        });
+    }
+    scene.vertex_count = scene.vertex_allocator.end();
+    scene.index_count  = scene.index_allocator.end();
 }
 
 auto app::write_geometry_buffers() -> void
 {
-    if(scene.geometry_buffer.data == nullptr || scene.geometry_buffer.size == 0) return;
+    GHUVA_TRACE_ZONE("app::write_geometry_buffers");
+    auto queue = ctx.device.getQueue();
 
-    auto const position_start = scene.geometry_buffer.data;
-    auto const color_start    = position_start + scene.geometry_buffer.size / 3;
-    auto const normal_start   = color_start    + scene.geometry_buffer.size / 3;
-    auto const index_start    = scene.index_buffer.data;
+    // One-offs, these stay on writeBuffer instead of pinning a staging slot as big as all
+    // the meshes put together.
+    for(auto const i : scene.pending_uploads)
+    {
+        auto const& mesh = params.meshes[i];
+        auto const& m    = scene.geometry_offsets[i];
 
-    ctx.device.getQueue().writeBuffer(ctx.vertex_buffer, 0, position_start,  scene.geometry_buffer.byte_size() / 3);
-    ctx.device.getQueue().writeBuffer(ctx.color_buffer,  0, color_start,     scene.geometry_buffer.byte_size() / 3);
-    ctx.device.getQueue().writeBuffer(ctx.normal_buffer, 0, normal_start,    scene.geometry_buffer.byte_size() / 3);
-    ctx.device.getQueue().writeBuffer(ctx.index_buffer,  0, index_start,     scene.index_buffer.byte_size());
+        auto const vertex_offset = m.start_vertex * 3 * sizeof(ghuva::context::vertex_t);
+        queue.writeBuffer(ctx.vertex_buffer, vertex_offset, mesh.vertexes.data(), mesh.vertexes.size() * sizeof(ghuva::context::vertex_t));
+        queue.writeBuffer(ctx.color_buffer,  vertex_offset, mesh.colors.data(),   mesh.colors.size()   * sizeof(ghuva::context::vertex_t));
+        queue.writeBuffer(ctx.normal_buffer, vertex_offset, mesh.normals.data(),  mesh.normals.size()  * sizeof(ghuva::context::vertex_t));
 
-    if(scene.instance_buffer.data == nullptr || scene.instance_buffer.size == 0) return;
-    ctx.device.getQueue().writeBuffer(ctx.object_uniform_buffer, 0, scene.instance_buffer.data, scene.instance_buffer.byte_size());
+        scene.index_scratch.assign(mesh.indexes.begin(), mesh.indexes.end());
+        if(scene.index_scratch.size() % 2) scene.index_scratch.push_back(0);
+        queue.writeBuffer(ctx.index_buffer, m.start_index * sizeof(ghuva::context::index_t), scene.index_scratch.data(), scene.index_scratch.size() * sizeof(ghuva::context::index_t));
+    }
+    scene.pending_uploads.clear();
+
+    // The scene uniform and instances were staged while building them.
+    ctx.submit_staged();
 }
 
 auto app::do_ui(f32 dt) -> void
 {
+    GHUVA_TRACE_ZONE("app::do_ui");
     ctx.imgui_new_frame();
 
     ImGui::BeginMainMenuBar();
     {
         auto const frame_str = fmt::format(
-            "{:.1f} FPS ({:.1f}ms) / Scene buffers: G({}b/{}b) In({}b/{}b) Idx({}b/{}b) / {} Renderables / {} Ticks - {} TPS ({:.1f}ms) / Frame {}",
+            "{:.1f} FPS ({:.1f}ms) / Scene buffers: G({}b/{}b) Idx({}b/{}b) In({}b in {} chunks, {} dirty ranges) / {} Renderables / {} Ticks - {} TPS ({:.1f}ms) / Frame {}",
             1 / dt, dt * 1000,
-            scene.geometry_buffer.byte_size(), scene.geometry_buffer.byte_capacity(),
-            scene.index_buffer.byte_size(),    scene.index_buffer.byte_capacity(),
-            scene.instance_buffer.byte_size(), scene.instance_buffer.byte_capacity(),
-            params.object_count,
+            scene.vertex_count * 3 * 3 * sizeof(ghuva::context::vertex_t), ctx.vertex_capacity * 3 * 3 * sizeof(ghuva::context::vertex_t), // xyz, rgb and normals.
+            scene.index_count * sizeof(ghuva::context::index_t),            ctx.index_capacity * sizeof(ghuva::context::index_t),
+            scene.instance_count * sizeof(ghuva::context::object_uniforms), ctx.object_chunks.size(), scene.dirty_instances.size(),
+            scene.instance_count,
             params.engine.ticks, params.engine.tps, 1 / params.engine.tps * 1000,
             ctx.frame
         );
@@ -321,6 +654,27 @@ auto app::do_ui(f32 dt) -> void
             ImGui::SameLine();
             ui_help("Whether or not to use multiple threads to do object ticking");
 
+            ImGui::BeginDisabled(!outputs.parallel_ticking);
+            if(ImGui::Checkbox("Job pool", &outputs.job_pool))
+            { outputs.do_engine_config_update = true; }
+            ImGui::SameLine();
+            ui_help("Whether to tick objects using the engine's work-stealing job pool or OpenMP");
+            ImGui::PushItemWidth(100);
+            if(ImGui::InputInt("Workers", &outputs.tick_workers * cvt::rc<int*>, 1, 4))
+            {
+                outputs.do_engine_config_update = true;
+                outputs.tick_workers = ghuva::m::clamp(outputs.tick_workers * cvt::to<int>, 0, 256) * cvt::to<u32>;
+            }
+            ImGui::SameLine();
+            ui_help("How many threads to tick objects with, 0 = as many as there are cores");
+            ImGui::EndDisabled();
+
+            ImGui::NewLine();
+
+            if(ImGui::Button("Compact geometry")) scene.compact_requested = true;
+            ImGui::SameLine();
+            ui_help("Packs the mesh geometry back together on the GPU, closing the holes left by meshes that are gone. Happens by itself when a new mesh doesn't fit otherwise");
+
             ImGui::EndMenu();
         }
 
@@ -452,21 +806,28 @@ auto app::ui_draw_matrix(ghuva::m4f const& m, const char* panelname, const char*
 
 auto app::compute_transform_matrix_via_compute_pass() -> void
 {
-    if(scene.instance_buffer.data == nullptr || scene.instance_buffer.size == 0) return;
+    GHUVA_TRACE_ZONE("app::compute_pass");
+    if(scene.dirty_instances.empty()) return; // The rest were converted back when they got uploaded.
 
     auto compute_pass = ctx.begin_compute();
 
     compute_pass.setPipeline(ctx.compute_pipeline);
-    compute_pass.setBindGroup(0, ctx.compute_bind_group, 0, nullptr);
-    auto const workgroup_size = 64; // Defined in the shader.
-    auto const dispatched     = (params.object_count + workgroup_size - 1) / workgroup_size; // Round up.
-    compute_pass.dispatchWorkgroups(dispatched, 1, 1);
+    for(auto k = 0_u64; k < scene.dirty_instances.size(); ++k)
+    {
+        auto const& r             = scene.dirty_instances[k];
+        auto const range_offset   = (k * ctx.compute_range_stride) * cvt::to<u32>;
+        auto const workgroup_size = 64_u64; // Defined in the shader.
+        auto const dispatched     = (r.count + workgroup_size - 1) / workgroup_size; // Round up.
+        compute_pass.setBindGroup(0, ctx.object_chunks[r.first / ctx.object_chunk_limit].compute_bind_group, 1, &range_offset);
+        compute_pass.dispatchWorkgroups(dispatched * cvt::to<u32>, 1, 1);
+    }
 
     ctx.end_compute(compute_pass);
 }
 
 auto app::render() -> ghuva::context::loop_message
 {
+    GHUVA_TRACE_ZONE("app::render");
     auto next_texture = ctx.swapchain.getCurrentTextureView();
     if(!next_texture) return ghuva::context::loop_message::do_break;
 
@@ -480,31 +841,43 @@ auto app::render() -> ghuva::context::loop_message
 
 auto app::render_emit_draw_calls(wgpu::RenderPassEncoder render_pass) -> void
 {
-    if(scene.geometry_buffer.data == nullptr || scene.geometry_buffer.size == 0) return;
-    if(scene.instance_buffer.data == nullptr || scene.instance_buffer.size == 0) return;
-    if(scene.index_buffer.data == nullptr    || scene.index_buffer.size == 0)    return;
+    if(scene.vertex_count == 0 || scene.index_count == 0) return;
+    if(scene.instance_count == 0) return;
 
     render_pass.setPipeline(ctx.pipeline);
     render_pass.setBindGroup(0, ctx.scene_bind_group, 0, nullptr);
-    render_pass.setVertexBuffer(0, ctx.vertex_buffer, 0, scene.geometry_buffer.byte_size() / 3);
-    render_pass.setVertexBuffer(1, ctx.color_buffer,  0, scene.geometry_buffer.byte_size() / 3);
-    render_pass.setVertexBuffer(2, ctx.normal_buffer, 0, scene.geometry_buffer.byte_size() / 3);
-    render_pass.setVertexBuffer(3, ctx.object_uniform_buffer, 0, scene.instance_buffer.byte_size());
-    render_pass.setIndexBuffer(ctx.index_buffer, wgpu::IndexFormat::Uint16, 0, scene.index_buffer.byte_size());
-
-    auto curr_instance = 0_u32;
+    auto const vertex_bsize = scene.vertex_count * 3 * sizeof(ghuva::context::vertex_t);
+    render_pass.setVertexBuffer(0, ctx.vertex_buffer, 0, vertex_bsize);
+    render_pass.setVertexBuffer(1, ctx.color_buffer,  0, vertex_bsize);
+    render_pass.setVertexBuffer(2, ctx.normal_buffer, 0, vertex_bsize);
+    render_pass.setIndexBuffer(ctx.index_buffer, wgpu::IndexFormat::Uint16, 0, scene.index_count * sizeof(ghuva::context::index_t));
+
+    // A mesh's instances can straddle chunks, in which case it takes a draw per chunk.
+    auto const limit   = ctx.object_chunk_limit;
+    auto bound_chunk   = ~0_u64;
+    auto curr_instance = 0_u64;
     for(auto m : scene.geometry_offsets)
     {
-        if(m.instance_count == 0) continue;
-
-        render_pass.drawIndexed(
-            m.index_count,
-            m.instance_count,
-            m.start_index,
-            m.start_vertex,
-            curr_instance
-        );
+        auto const end = curr_instance + m.instance_count;
+        while(curr_instance < end)
+        {
+            auto const chunk = curr_instance / limit;
+            auto const count = std::min(end, (chunk + 1) * limit) - curr_instance;
+            if(chunk != bound_chunk)
+            {
+                auto const in_chunk = std::min(limit, scene.instance_count - chunk * limit);
+                render_pass.setVertexBuffer(3, ctx.object_chunks[chunk].buffer, 0, in_chunk * sizeof(ghuva::context::object_uniforms));
+                bound_chunk = chunk;
+            }
 
-        curr_instance += m.instance_count;
+            if(m.index_count != 0) render_pass.drawIndexed(
+                m.index_count * cvt::to<u32>,
+                count * cvt::to<u32>,
+                m.start_index * cvt::to<u32>,
+                m.start_vertex * cvt::to<i32>,
+                (curr_instance - chunk * limit) * cvt::to<u32>
+            );
+            curr_instance += count;
+        }
     }
 }
@@ -2,10 +2,11 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "ghuva/context.hpp"
 
-#include "ghuva/utils/container.hpp"
+#include "ghuva/utils/range_allocator.hpp"
 #include "ghuva/utils/aliases.hpp"
 #include "ghuva/utils/point.hpp"
 #include "ghuva/transform.hpp"
@@ -17,9 +18,10 @@ struct app
 {
     struct object /* this is app::object, not to be confused with ghuva::object */
     {
+        ghuva::u64 id;
         ghuva::u64 mesh_id;
         ghuva::transform t;
-        ghuva::u64 mesh_index; // Maintained by the app, don't worry about it.
+        ghuva::transform previous_t; // Where it was a tick ago, drawn at lerp(previous_t, t, interpolation_alpha).
     };
 
     struct /* params */ // Set these from your own callback during loop.
@@ -33,19 +35,33 @@ struct app
             ghuva::f32 max_tps            = 100'000.f;
             ghuva::u64 ticks              = 0; // Since last loop.
             bool       parallel_ticking   = true; // Is parallel ticking enabled on the engine ?
+            bool       job_pool           = true; // Is it using the job pool instead of OpenMP ?
+            ghuva::u32 tick_workers       = 0;    // 0 = as many as there are cores.
 
             // Main loop config stuff.
             bool has_own_thread = true; // Is the engine running on a dedicated thread ?
         } engine;
 
         // You cleanup after yourself, we only want a view into these vectors.
-        // You are expected to verify that all objects have valid mesh_ids and
-        // only the mesh_ids used are in the mesh vector.
-        // NOTE: notice how these are not const*, we WILL modify their contents.
+        // Objects whose mesh_id isn't in the mesh vector are kept around but not drawn.
+        // NOTE: notice how meshes is not const*, we WILL modify its contents.
         ghuva::mesh* meshes       = nullptr;
         ghuva::u64   mesh_count   = 0;
-        object *     objects      = nullptr;
-        ghuva::u64   object_count = 0;
+        ghuva::u64   meshes_generation = 0; // Change it whenever meshes does, geometry only gets rebuilt then.
+        bool         meshes_reset = true; // Set along with it if an id might now be for another mesh (e.g. after loading
+                                          // a snapshot), the meshes already on the GPU only get checked again then.
+
+        // What changed since the last objects_generation: the objects that showed up or changed
+        // and the ids of the ones that are gone (or shouldn't be drawn anymore, unknown ids are fine).
+        // Anything not in objects is done moving. With objects_reset, objects is all of them and
+        // whatever else the app had gets dropped.
+        object const*     objects         = nullptr;
+        ghuva::u64        object_count    = 0;
+        ghuva::u64 const* deleted_objects = nullptr;
+        ghuva::u64        deleted_count   = 0;
+        bool              objects_reset   = true;
+        ghuva::u64        objects_generation = 0; // Change it along with the above, they only get looked at then.
+        ghuva::f32        interpolation_alpha = 1.f; // 1 = draw objects exactly at t.
 
         struct /* camera */
         {
@@ -66,6 +82,8 @@ struct app
         ghuva::f32 target_tps             = 120.0f;
         ghuva::f32 target_time_multiplier = 1.0f;
         bool parallel_ticking             = true;
+        bool job_pool                     = true;
+        ghuva::u32 tick_workers           = 0;
 
         bool engine_has_dedicated_thread  = true;
     } outputs;
@@ -84,6 +102,17 @@ private:
     auto sync_params_to_outputs() -> void;
     auto write_scene_uniform() -> void;
     auto build_scene_geometry() -> void;
+        auto sync_scene_meshes(bool compact) -> void;
+        auto sync_instances() -> void;
+        auto regroup_instances() -> void;
+        auto insert_instance(object const&) -> void;
+        auto erase_instance(ghuva::u64 slot) -> void;
+        auto swap_instances(ghuva::u64 a, ghuva::u64 b) -> void;
+        auto instance_group(ghuva::u64 mesh_id) const -> ghuva::u64;
+        auto count_instances() -> void;
+        auto refresh_instances() -> void;
+        auto mark_instance_dirty(ghuva::u64 i) -> void;
+        auto upload_dirty_instances() -> void;
     auto write_geometry_buffers() -> void;
     auto do_ui(ghuva::f32 dt) -> void;
         auto ui_help(const char*) -> void;
@@ -130,12 +159,57 @@ private:
             ghuva::u64 index_count;
             ghuva::u64 start_vertex;
         };
-        std::vector<mesh_data> geometry_offsets; // Where each mesh sits within the buffer.
+        std::vector<mesh_data> geometry_offsets; // Where each mesh sits within the buffers, same order as params.meshes.
 
-        // Contains position + color + normal buffers. Divide size by 3 to get the offsets
-        // for each buffer within this.
-        ghuva::container<ghuva::context::vertex_t> geometry_buffer;
-        ghuva::container<ghuva::context::index_t>  index_buffer;
-        ghuva::container<ghuva::context::object_uniforms> instance_buffer;
+        // Where a mesh's geometry lives on the GPU, from the moment it shows up in
+        // params.meshes until it's gone from there.
+        struct mesh_slot
+        {
+            ghuva::range_allocator::range vertexes; // In vertexes, same spot in the vertex, color and normal buffers.
+            ghuva::range_allocator::range indexes;  // In indexes, always an even count so uploads stay 4 byte aligned.
+            ghuva::u64 hash; // Of the mesh's data, tells apart meshes that reuse an id (e.g. after loading a snapshot).
+        };
+        std::unordered_map<ghuva::u64, mesh_slot> mesh_slots; // Mesh id -> slot.
+        ghuva::range_allocator vertex_allocator;
+        ghuva::range_allocator index_allocator;
+
+        // The geometry lives on the GPU only, uploaded straight from params.meshes
+        // when they change.
+        ghuva::u64 meshes_generation = ~ghuva::u64{0}; // params.meshes_generation the geometry is for.
+        ghuva::u64 vertex_count = 0; // In use in each of the vertex, color and normal buffers, holes included.
+        ghuva::u64 index_count  = 0; // In use in the index buffer, holes included.
+        bool compact_requested  = false; // Set by the UI, packs all the geometry back together.
+        std::vector<ghuva::u64> pending_uploads; // Indexes into params.meshes not on the GPU yet.
+        std::vector<ghuva::context::index_t> index_scratch; // Padded copy for uploads, writeBuffer wants multiples of 4 bytes.
+
+        // The objects, a slot each, grouped by mesh in the same order as geometry_offsets so each
+        // mesh's instances sit together (the ones whose mesh isn't around go last and aren't drawn).
+        // An object keeps its slot until something comes or goes in front of it, and even then only
+        // one slot per group after that moves. See insert_instance() and erase_instance().
+        ghuva::u64 instance_count = 0;
+        std::vector<ghuva::u64>       instance_ids;
+        std::vector<ghuva::u64>       instance_mesh_ids;
+        std::vector<ghuva::transform> instance_t;
+        std::vector<ghuva::transform> instance_previous_t;
+        std::unordered_map<ghuva::u64, ghuva::u64> instance_slots; // Object id -> slot.
+        std::vector<ghuva::u64> instance_group_ends = std::vector<ghuva::u64>(1); // geometry_offsets.size() + 1 of them.
+        std::vector<ghuva::u64> moving_instances;  // Slots with previous_t != t, interpolation_alpha moves them around.
+        std::vector<ghuva::u64> touched_instances; // Slots that might not match what's on the GPU anymore.
+
+        // What's in the object chunks, as the blended transforms they were made from, so only
+        // what changed gets uploaded again. The compute pass converts them in place, so it
+        // also only goes over what was just uploaded. By slot, good up to uploaded_instances.
+        std::vector<ghuva::transform> instances;
+        ghuva::u64 uploaded_instances = 0;
+        ghuva::u64 objects_generation = ~ghuva::u64{0}; // params.objects_generation the instances are for.
+        ghuva::f32 instances_alpha    = 1.f;  // params.interpolation_alpha the moving ones are at.
+        bool       instances_computed = true; // Whether they were uploaded for the compute pass or as matrixes.
+
+        struct instance_range
+        {
+            ghuva::u64 first;
+            ghuva::u64 count;
+        };
+        std::vector<instance_range> dirty_instances; // Uploaded this frame, in order and never across a chunk.
     } scene;
 };
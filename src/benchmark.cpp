@@ -0,0 +1,263 @@
+// Ticks the engine on its own, no window or GPU, and reports how long each part of the
+// tick took as percentiles in JSON. Every scene gets run for each object count, thread
+// count and way of ticking asked for. Run with --help for the options.
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <array>
+
+#include "ghuva/utils/chrono.hpp"
+#include "ghuva/utils/cvt.hpp"
+#include "ghuva/perf_history.hpp"
+#include "ghuva/engine.hpp"
+
+using namespace ghuva::aliases;
+namespace g = ghuva;
+
+namespace
+{
+    struct nudge { f32 dx; };
+    using engine_t = g::engine< g::impl::type_list<>, g::impl::type_list< g::message<nudge> > >;
+
+    enum class scene : u8 { pyramids, messages, deletes };
+    constexpr auto scene_names = std::array{ "pyramids", "messages", "deletes" };
+
+    // How the objects get ticked, parallel_ticking off or on with either backend.
+    enum class mode : u8 { serial, openmp, job_pool };
+    constexpr auto mode_names = std::array{ "serial", "openmp", "job_pool" };
+
+    struct options
+    {
+        std::vector<::scene> scenes  = { scene::pyramids, scene::messages, scene::deletes };
+        std::vector<u64>     objects = { 1'000, 16'000, 100'000 };
+        std::vector<u32>     threads; // Empty = 1 up to hardware_concurrency, doubling.
+        std::vector<::mode>  modes   = { mode::serial, mode::openmp, mode::job_pool };
+        u64 ticks  = 500;
+        u64 warmup = 50;
+        std::optional<std::string> out; // stdout otherwise.
+    };
+
+    auto load_scene(engine_t& engine, ::scene scene, u64 objects) -> void;
+    auto run(::scene scene, u64 objects, u32 threads, ::mode mode, options const& opts, std::FILE* out, bool first) -> void;
+    auto parse(int argc, char** argv) -> std::optional<options>;
+}
+
+int main(int argc, char** argv)
+{
+    auto const opts = parse(argc, argv);
+    if(!opts) return 1;
+
+    std::FILE* out = stdout;
+    if(opts->out && !(out = std::fopen(opts->out->c_str(), "w")))
+    {
+        fmt::print(stderr, "[benchmark] Couldn't open {}\n", *opts->out);
+        return 1;
+    }
+
+    auto threads = opts->threads;
+    if(threads.empty())
+    {
+        auto const max = std::max(std::thread::hardware_concurrency(), 1u);
+        for(auto t = 1u; t < max; t *= 2) threads.push_back(t);
+        threads.push_back(max);
+    }
+
+    fmt::print(out, "{{\n  \"ticks\": {},\n  \"warmup\": {},\n  \"runs\": [", opts->ticks, opts->warmup);
+    auto first = true;
+    for(auto const scene : opts->scenes)
+    for(auto const objects : opts->objects)
+    for(auto const mode : opts->modes)
+    for(auto const t : threads)
+    {
+        // Thread count doesn't matter when ticking serially.
+        if(mode == mode::serial && t != threads.front()) continue;
+        run(scene, objects, mode == mode::serial ? 1 : t, mode, *opts, out, first);
+        first = false;
+    }
+    fmt::print(out, "\n  ]\n}}\n");
+
+    if(out != stdout) std::fclose(out);
+    return 0;
+}
+
+namespace
+{
+    // Spins around one axis, like the pyramids in main.
+    constexpr auto spin_around(u64 axis)
+    {
+        return [axis](auto& objects, f32 dt, auto const&, auto&){
+            for(auto i = 0_u64; i < objects.size(); ++i) objects.transforms[i].rot[axis] += dt;
+        };
+    }
+
+    auto load_scene(engine_t& engine, ::scene scene, u64 objects) -> void
+    {
+        auto const spinners = std::array{
+            engine.add_system("Spinner x", spin_around(0)),
+            engine.add_system("Spinner y", spin_around(1)),
+            engine.add_system("Spinner z", spin_around(2)),
+        };
+
+        switch(scene)
+        {
+        // A system per axis, the cheapest there is per object.
+        case scene::pyramids:
+            for(auto axis = 0_u64; axis < spinners.size(); ++axis)
+                engine.post(engine_t::register_objects{
+                    .prototype = {{ .name = "Pyramid", .mesh_id = 1, .system = spinners[axis] }},
+                    .count = (axis + 1) * objects / spinners.size() - axis * objects / spinners.size(),
+                });
+            break;
+
+        // Every object messages the next one each tick and moves by what it got.
+        case scene::messages:
+            engine.post(engine_t::register_objects{ .prototype = {{
+                .name = "Chatty",
+                .on_tick = [](auto& self, auto, auto const& snapshot, auto& engine){
+                    for(auto const& m : snapshot.template read_messages<nudge>(self)) self.t.pos.x += m.body.dx;
+
+                    auto const ids  = snapshot.objects.ids();
+                    auto const next = (snapshot.index_of(self.id) + 1) % ids.size();
+                    engine.message(nudge{ .dx = 0.001f }, ids[next], self.id);
+                },
+                .mesh_id = 1,
+            }}, .count = objects });
+            break;
+
+        // 1% of the objects get deleted and as many registered each tick, by an object of its own.
+        case scene::deletes:
+            engine.post(engine_t::register_objects{ .prototype = {{ .name = "Mayfly", .mesh_id = 1, .system = spinners[0] }}, .count = objects });
+            engine.post(engine_t::register_object{ .object = {{
+                .name = "Reaper",
+                .on_tick = [spinners, per_tick = std::max(objects / 100, 1_u64)](auto& self, auto, auto const& snapshot, auto& engine){
+                    auto const ids = snapshot.objects.ids();
+                    for(auto i = 0_u64, deleted = 0_u64; i < ids.size() && deleted < per_tick; ++i)
+                    {
+                        auto const id = ids[(snapshot.id * per_tick + i) % ids.size()];
+                        if(id == self.id) continue;
+                        engine.post(engine_t::delete_object{ .id = id, .success = false }, self.id);
+                        ++deleted;
+                    }
+                    auto const spinner = spinners[snapshot.id % spinners.size()];
+                    engine.post(engine_t::register_objects{ .prototype = {{ .name = "Mayfly", .mesh_id = 1, .system = spinner }}, .count = per_tick }, self.id);
+                },
+                .draw = false,
+            }}});
+            break;
+        }
+    }
+
+    auto run(::scene scene, u64 objects, u32 threads, ::mode mode, options const& opts, std::FILE* out, bool first) -> void
+    {
+        auto engine = std::make_unique<engine_t>();
+        engine->post(engine_t::set_parallel_ticking{ .parallel_ticking = mode != mode::serial });
+        engine->post(engine_t::set_tick_backend{ .tick_backend = mode == mode::openmp ? g::tick_backend::openmp : g::tick_backend::job_pool });
+        engine->post(engine_t::set_tick_workers{ .tick_workers = threads });
+        load_scene(*engine, scene, objects);
+
+        for(auto i = 0_u64; i < opts.warmup; ++i) engine->step();
+
+        // Read back every tick, the history only goes back so far.
+        auto records = std::vector<g::perf_record>{};
+        records.reserve(opts.ticks);
+        auto stopwatch = g::chrono::stopwatch();
+        for(auto tick = 0_u64; tick < opts.ticks; ++tick)
+        {
+            engine->step();
+            auto const last = engine->perf_history(1);
+            records.insert(records.end(), last.begin(), last.end());
+        }
+        auto const seconds = stopwatch.click().last_segment();
+        auto const objects_at_end = engine->take_snapshot()->objects.size();
+
+        fmt::print(out, "{}\n    {{ \"scene\": \"{}\", \"objects\": {}, \"mode\": \"{}\", \"threads\": {}, \"seconds\": {:.6f}, \"objects_at_end\": {}, \"phases\": {{",
+            first ? "" : ",", scene_names[g::cvt::to<u64>(scene)], objects, mode_names[g::cvt::to<u64>(mode)], threads, seconds, objects_at_end);
+        for(auto i = 0_u64; i < g::perf_phases.size(); ++i)
+        {
+            auto const& phase = g::perf_phases[i];
+            auto const p = g::percentiles(records, phase.seconds);
+            fmt::print(out, "{}\n      \"{}\": {{ \"p50\": {:.9f}, \"p95\": {:.9f}, \"p99\": {:.9f}, \"max\": {:.9f} }}",
+                i == 0 ? "" : ",", phase.name, p.p50, p.p95, p.p99, p.max);
+        }
+        fmt::print(out, "\n    }} }}");
+        std::fflush(out);
+    }
+
+    template <typename T>
+    auto parse_list(std::string_view s, std::vector<T>& into) -> bool
+    {
+        into.clear();
+        while(!s.empty())
+        {
+            auto const comma = std::min(s.find(','), s.size());
+            auto value = T{};
+            auto const [end, ec] = std::from_chars(s.data(), s.data() + comma, value);
+            if(ec != std::errc{} || end != s.data() + comma) return false;
+            into.push_back(value);
+            s.remove_prefix(std::min(comma + 1, s.size()));
+        }
+        return !into.empty();
+    }
+
+    template <typename E, u64 N>
+    auto parse_names(std::string_view s, std::array<char const*, N> const& names, std::vector<E>& into) -> bool
+    {
+        into.clear();
+        while(!s.empty())
+        {
+            auto const comma = std::min(s.find(','), s.size());
+            auto const it    = std::find(names.begin(), names.end(), s.substr(0, comma));
+            if(it == names.end()) return false;
+            into.push_back(static_cast<E>(it - names.begin()));
+            s.remove_prefix(std::min(comma + 1, s.size()));
+        }
+        return !into.empty();
+    }
+
+    auto parse(int argc, char** argv) -> std::optional<options>
+    {
+        constexpr auto usage =
+            "Usage: {} [options]\n"
+            "  --scenes  pyramids,messages,deletes\n"
+            "  --objects 1000,16000,100000\n"
+            "  --threads 1,2,4         (default 1 up to the core count, doubling)\n"
+            "  --modes   serial,openmp,job_pool\n"
+            "  --ticks   500           (measured, per run)\n"
+            "  --warmup  50            (not measured, per run)\n"
+            "  --out     results.json  (default stdout)\n";
+
+        auto opts = options{};
+        for(auto i = 1; i < argc; ++i)
+        {
+            auto const arg   = std::string_view(argv[i]);
+            auto const value = i + 1 < argc ? std::string_view(argv[i + 1]) : std::string_view{};
+            auto ticks = std::vector<u64>{};
+
+            auto ok = !value.empty();
+                 if(arg == "--scenes")  ok = ok && parse_names(value, scene_names, opts.scenes);
+            else if(arg == "--objects") ok = ok && parse_list(value, opts.objects);
+            else if(arg == "--threads") ok = ok && parse_list(value, opts.threads);
+            else if(arg == "--modes")   ok = ok && parse_names(value, mode_names, opts.modes);
+            else if(arg == "--ticks")   { ok = ok && parse_list(value, ticks) && ticks.size() == 1; if(ok) opts.ticks  = ticks[0]; }
+            else if(arg == "--warmup")  { ok = ok && parse_list(value, ticks) && ticks.size() == 1; if(ok) opts.warmup = ticks[0]; }
+            else if(arg == "--out")     opts.out = std::string(value);
+            else ok = false;
+
+            if(!ok)
+            {
+                fmt::print(stderr, usage, argv[0]);
+                return std::nullopt;
+            }
+            ++i;
+        }
+        return opts;
+    }
+}
@@ -13,11 +13,13 @@
 #include <backends/imgui_impl_glfw.h>
 
 #include <stdio.h>
+#include <algorithm>
 
 #ifdef __EMSCRIPTEN__
     #define IS_NATIVE 0
 #else
     #define IS_NATIVE 1
+    #include <webgpu/wgpu.h> // wgpuDevicePoll().
 #endif
 
 #include <fmt/core.h>
@@ -285,38 +287,7 @@ auto ghuva::context::init_bindings() -> void
     //this->object_bind_group = device.createBindGroup(this->desc.object_bind_group_descriptor);
     //std::cout << "\t" << this->object_bind_group << std::endl;
 
-    // Compute bindings below.
-    this->desc.bindings[2] = {
-        .nextInChain = nullptr,
-        .binding = 0,
-        .buffer = this->object_uniform_buffer,
-        .offset = 0,
-        .size = this->object_uniform_limit * sizeof(compute_object_uniforms),
-        .sampler = nullptr,
-        .textureView = nullptr,
-    };
-
-    std::cout << "[wgpu] Creating compute bind group layout ..." << std::endl;
-    this->bind_group_layouts[2] = this->create_bind_group_layout({{{
-        .nextInChain = nullptr,
-        .binding = 0,
-        .visibility = wgpu::ShaderStage::Compute,
-        .buffer = {
-            .nextInChain = nullptr,
-            .type = wgpu::BufferBindingType::Storage,
-            .hasDynamicOffset = false,
-            .minBindingSize = sizeof(compute_object_uniforms),
-        },
-        .sampler        = {},
-        .texture        = {},
-        .storageTexture = {},
-    }}});
-    std::cout << "\t" << this->bind_group_layouts[2] << std::endl;
-    wgpu::BindGroupDescriptor bindGroupDesc;
-    bindGroupDesc.layout = this->bind_group_layouts[2];
-    bindGroupDesc.entryCount = 1;
-    bindGroupDesc.entries = &this->desc.bindings[2];
-    this->compute_bind_group = this->device.createBindGroup(bindGroupDesc);
+    // The compute bind groups get made along with the object chunks, see reserve_objects().
 }
 
 auto ghuva::context::init_render_pipeline() -> void
@@ -466,7 +437,7 @@ auto ghuva::context::init_compute_pipeline() -> void
     );
 
     std::cout << "[wgpu] Creating compute bind group layout ..." << std::endl;
-    this->bind_group_layouts[2] = this->create_bind_group_layout({{{
+    this->bind_group_layouts[2] = this->create_bind_group_layout({{
         .nextInChain = nullptr,
         .binding = 0,
         .visibility = wgpu::ShaderStage::Compute,
@@ -479,7 +450,20 @@ auto ghuva::context::init_compute_pipeline() -> void
         .sampler        = {},
         .texture        = {},
         .storageTexture = {},
-    }}});
+    }, {
+        .nextInChain = nullptr,
+        .binding = 1,
+        .visibility = wgpu::ShaderStage::Compute,
+        .buffer = {
+            .nextInChain = nullptr,
+            .type = wgpu::BufferBindingType::Uniform,
+            .hasDynamicOffset = true,
+            .minBindingSize = sizeof(compute_range),
+        },
+        .sampler        = {},
+        .texture        = {},
+        .storageTexture = {},
+    }});
     std::cout << "\t" << this->bind_group_layouts[2] << std::endl;
 
     this->desc.compute_pipeline_layout = {
@@ -526,8 +510,8 @@ auto ghuva::context::init_buffers() -> void
     this->desc.vertex_buffer = {
         .nextInChain = nullptr,
         .label = "Vertex (position) buffer",
-        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex,
-        .size  = this->vertex_count * 3 * sizeof(vertex_t),
+        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::Vertex,
+        .size  = this->vertex_capacity * 3 * sizeof(vertex_t),
         .mappedAtCreation = false,
     };
     this->vertex_buffer = device.createBuffer(this->desc.vertex_buffer);
@@ -537,7 +521,7 @@ auto ghuva::context::init_buffers() -> void
     this->desc.color_buffer = {
         .nextInChain = nullptr,
         .label = "Vertex (color) buffer",
-        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex,
+        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::Vertex,
         .size  = this->desc.vertex_buffer.size,
         .mappedAtCreation = false,
     };
@@ -548,7 +532,7 @@ auto ghuva::context::init_buffers() -> void
     this->desc.normal_buffer = {
         .nextInChain = nullptr,
         .label = "Vertex (normal) buffer",
-        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex,
+        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::Vertex,
         .size  = this->desc.vertex_buffer.size,
         .mappedAtCreation = false,
     };
@@ -559,8 +543,8 @@ auto ghuva::context::init_buffers() -> void
     this->desc.index_buffer = {
         .nextInChain = nullptr,
         .label = "Index buffer",
-        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Index,
-        .size = this->index_count * sizeof(index_t),
+        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::Index,
+        .size = this->index_capacity * sizeof(index_t),
         .mappedAtCreation = false,
     };
     this->index_buffer = device.createBuffer(this->desc.index_buffer);
@@ -577,16 +561,35 @@ auto ghuva::context::init_buffers() -> void
     this->scene_uniform_buffer = device.createBuffer(this->desc.scene_uniform_buffer);
     std::cout << "\t" << this->scene_uniform_buffer << std::endl;
 
-    std::cout << "[wgpu] Creating object vertex buffer..." << std::endl;
+    // Only the descriptor for now, the chunks get made as needed by reserve_objects().
 	this->desc.object_uniform_buffer = {
         .nextInChain = nullptr,
         .label = "Object uniform buffer",
-        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex | wgpu::BufferUsage::Storage,
-        .size = this->object_uniform_limit * sizeof(object_uniforms),
+        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::Vertex | wgpu::BufferUsage::Storage,
+        .size = 0,
+        .mappedAtCreation = false,
+    };
+    // Each chunk has to fit in a buffer, be bindable as storage for the compute pass and
+    // be covered by a single dispatch of it (64 per workgroup, defined in the shader).
+    auto const& l = this->limits.device.limits;
+    this->object_chunk_limit = std::min({
+        l.maxBufferSize / sizeof(object_uniforms),
+        l.maxStorageBufferBindingSize / sizeof(object_uniforms),
+        l.maxComputeWorkgroupsPerDimension * 64_u64,
+    });
+    std::cout << "[wgpu] Object chunks fit up to " << this->object_chunk_limit << " objects" << std::endl;
+
+    std::cout << "[wgpu] Creating compute range buffer..." << std::endl;
+    this->compute_range_stride = ceil_to_next_multiple(sizeof(compute_range), l.minUniformBufferOffsetAlignment);
+    this->desc.compute_range_buffer = {
+        .nextInChain = nullptr,
+        .label = "Compute range buffer",
+        .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform,
+        .size = this->compute_range_stride * this->max_compute_ranges,
         .mappedAtCreation = false,
     };
-    this->object_uniform_buffer = device.createBuffer(this->desc.object_uniform_buffer);
-    std::cout << "\t" << this->object_uniform_buffer << std::endl;
+    this->compute_range_buffer = device.createBuffer(this->desc.compute_range_buffer);
+    std::cout << "\t" << this->compute_range_buffer << std::endl;
 }
 
 auto ghuva::context::init_textures() -> void
@@ -745,6 +748,196 @@ auto ghuva::context::end_render(wgpu::RenderPassEncoder render_pass) -> void
     this->swapchain.present();
 }
 
+auto ghuva::context::reserve_vertexes(u64 count) -> bool
+{
+    if(count <= this->vertex_capacity) return true;
+
+    auto const max = this->limits.device.limits.maxBufferSize / (3 * sizeof(vertex_t));
+    if(count > max) return false;
+
+    this->vertex_capacity = std::min(std::max(count, this->vertex_capacity * 2), max);
+    auto const size = this->vertex_capacity * 3 * sizeof(vertex_t);
+    this->grow_buffer(this->vertex_buffer, this->desc.vertex_buffer, size);
+    this->grow_buffer(this->color_buffer,  this->desc.color_buffer,  size);
+    this->grow_buffer(this->normal_buffer, this->desc.normal_buffer, size);
+    return true;
+}
+
+auto ghuva::context::reserve_indexes(u64 count) -> bool
+{
+    if(count <= this->index_capacity) return true;
+
+    auto const max = this->limits.device.limits.maxBufferSize / sizeof(index_t) / 2 * 2; // Even, copies go 4 bytes at a time.
+    if(count > max) return false;
+
+    this->index_capacity = (std::min(std::max(count, this->index_capacity * 2), max) + 1) / 2 * 2;
+    this->grow_buffer(this->index_buffer, this->desc.index_buffer, this->index_capacity * sizeof(index_t));
+    return true;
+}
+
+auto ghuva::context::reserve_objects(u64 count) -> void
+{
+    auto const limit = this->object_chunk_limit;
+    auto const chunk_count = (count + limit - 1) / limit;
+    if(this->object_chunks.size() < chunk_count) this->object_chunks.resize(chunk_count);
+
+    for(auto c = 0_u64; c < chunk_count; ++c)
+    {
+        auto& chunk = this->object_chunks[c];
+        auto const wanted = c + 1 < chunk_count ? limit : count - c * limit;
+        if(wanted <= chunk.capacity) continue;
+
+        auto const capacity = std::min(std::max(wanted, chunk.capacity * 2), limit);
+        auto desc = this->desc.object_uniform_buffer;
+        if(chunk.buffer)
+        {
+            desc.size = chunk.capacity * sizeof(object_uniforms);
+            this->grow_buffer(chunk.buffer, desc, capacity * sizeof(object_uniforms));
+            chunk.compute_bind_group.drop();
+        }
+        else
+        {
+            desc.size = capacity * sizeof(object_uniforms);
+            chunk.buffer = this->device.createBuffer(desc);
+            this->buffer_growths.push_back({ .label = fmt::format("{} (chunk {})", desc.label, c), .from = 0, .to = desc.size, .frame = this->frame });
+            fmt::print("[wgpu] Created object chunk {} with room for {} objects\n", c, capacity);
+        }
+        chunk.capacity = capacity;
+
+        auto const entries = std::array{
+            WGPUBindGroupEntry{
+                .nextInChain = nullptr,
+                .binding = 0,
+                .buffer = chunk.buffer,
+                .offset = 0,
+                .size = chunk.capacity * sizeof(compute_object_uniforms),
+                .sampler = nullptr,
+                .textureView = nullptr,
+            },
+            WGPUBindGroupEntry{
+                .nextInChain = nullptr,
+                .binding = 1,
+                .buffer = this->compute_range_buffer,
+                .offset = 0,
+                .size = sizeof(compute_range),
+                .sampler = nullptr,
+                .textureView = nullptr,
+            },
+        };
+        auto group_desc = wgpu::BindGroupDescriptor{};
+        group_desc.layout = this->bind_group_layouts[2];
+        group_desc.entryCount = entries.size();
+        group_desc.entries = entries.data();
+        chunk.compute_bind_group = this->device.createBindGroup(group_desc);
+    }
+}
+
+auto ghuva::context::grow_buffer(wgpu::Buffer& buffer, WGPUBufferDescriptor& desc, u64 size) -> void
+{
+    auto const from = desc.size;
+    desc.size = size;
+    auto grown = this->device.createBuffer(desc);
+
+    auto encoder = this->device.createCommandEncoder({{ .nextInChain = nullptr, .label = "Buffer growth encoder" }});
+    encoder.copyBufferToBuffer(buffer, 0, grown, 0, from);
+    auto commands = encoder.finish({});
+    this->device.getQueue().submit(commands);
+    buffer.drop(); // Sticks around until the copy is done with it.
+    buffer = grown;
+
+    this->buffer_growths.push_back({ .label = desc.label, .from = from, .to = size, .frame = this->frame });
+    fmt::print("[wgpu] Grew {} from {}b to {}b\n", desc.label, from, size);
+}
+
+auto ghuva::context::stage(u64 size) -> staged
+{
+    constexpr auto alignment = 64_u64; // Enough for anything we put in there, copies only need 4.
+    size = (size + alignment - 1) / alignment * alignment;
+
+    auto const carve = [&](staging_slot& slot) -> staged {
+        auto const offset = slot.used;
+        slot.used += size;
+        return { .data = slot.mapped + offset, .buffer = slot.buffer, .offset = offset };
+    };
+
+    // Keep filling the last one while there's room.
+    if(!this->staging_batch.empty())
+        if(auto& slot = *this->staging_batch.back(); slot.used + size <= slot.capacity) return carve(slot);
+
+    // Otherwise take a free one, letting the ones in flight that are done get mapped back first.
+    #if IS_NATIVE
+        wgpuDevicePoll(this->device, false, nullptr);
+    #endif
+    staging_slot* pick = nullptr;
+    for(auto& slot : this->staging_slots)
+    {
+        if(slot->state != staging_slot::state_t::free) continue;
+        if(slot->capacity >= size) { pick = slot.get(); break; }
+        if(!pick) pick = slot.get(); // Too small, but it can be swapped for a bigger one.
+    }
+    if(!pick) pick = this->staging_slots.emplace_back(std::make_unique<staging_slot>()).get();
+    if(pick->capacity < size) this->make_staging_slot(*pick, std::max(size, this->staging_slot_size));
+
+    pick->state = staging_slot::state_t::writing;
+    this->staging_batch.push_back(pick);
+    return carve(*pick);
+}
+
+auto ghuva::context::copy_staged(staged const& from, wgpu::Buffer to, u64 to_offset, u64 size) -> void
+{
+    if(!this->staging_encoder)
+        this->staging_encoder = this->device.createCommandEncoder({{ .nextInChain = nullptr, .label = "Staging encoder" }});
+    this->staging_encoder.copyBufferToBuffer(from.buffer, from.offset, to, to_offset, size);
+}
+
+auto ghuva::context::submit_staged() -> void
+{
+    if(this->staging_batch.empty()) return;
+
+    for(auto* slot : this->staging_batch)
+    {
+        wgpuBufferUnmap(slot->buffer);
+        slot->mapped = nullptr;
+        slot->state  = staging_slot::state_t::in_flight;
+    }
+
+    if(this->staging_encoder)
+    {
+        auto commands = this->staging_encoder.finish({});
+        this->device.getQueue().submit(commands);
+        this->staging_encoder = {nullptr};
+    }
+
+    // Mapping only finishes once the GPU is done with everything submitted before it.
+    for(auto* slot : this->staging_batch)
+        wgpuBufferMapAsync(slot->buffer, WGPUMapMode_Write, 0, slot->capacity, [](WGPUBufferMapAsyncStatus status, void* userdata) {
+            auto& slot = *(cvt::rc<staging_slot*> + userdata);
+            slot.state = staging_slot::state_t::free;
+            slot.used  = 0;
+            if(status == WGPUBufferMapAsyncStatus_Success) slot.mapped = static_cast<std::byte*>(wgpuBufferGetMappedRange(slot.buffer, 0, slot.capacity));
+            else                                           slot.capacity = 0;
+        }, slot);
+    this->staging_batch.clear();
+}
+
+auto ghuva::context::make_staging_slot(staging_slot& slot, u64 capacity) -> void
+{
+    if(slot.buffer) slot.buffer.drop();
+
+    auto const desc = WGPUBufferDescriptor{
+        .nextInChain = nullptr,
+        .label = "Staging buffer",
+        .usage = wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc,
+        .size = capacity,
+        .mappedAtCreation = true,
+    };
+    slot.buffer   = this->device.createBuffer(desc);
+    slot.capacity = capacity;
+    slot.used     = 0;
+    slot.mapped   = static_cast<std::byte*>(wgpuBufferGetMappedRange(slot.buffer, 0, capacity));
+    fmt::print("[wgpu] Created a {}b staging buffer, {} in the ring\n", capacity, this->staging_slots.size());
+}
+
 auto ghuva::context::create_wgsl_shader(std::string code, std::string label) -> wgpu::ShaderModule
 {
     auto shader_wgsl  = wgpu::ShaderModuleWGSLDescriptor{};
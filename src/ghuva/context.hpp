@@ -7,8 +7,13 @@
 
 #include "utils/aliases.hpp"
 #include "utils/m4.hpp"
+#include "mesh.hpp"
 
 #include <optional>
+#include <memory>
+#include <cstddef>
+#include <string>
+#include <vector>
 #include <array>
 
 namespace ghuva
@@ -27,7 +32,8 @@ namespace ghuva
         WGPUSwapChainDescriptor swapchain = {};
 
         WGPUBufferDescriptor scene_uniform_buffer = {};
-        WGPUBufferDescriptor object_uniform_buffer = {};
+        WGPUBufferDescriptor object_uniform_buffer = {}; // Size is per chunk.
+        WGPUBufferDescriptor compute_range_buffer = {};
         WGPUBindGroupEntry bindings[3];
         WGPUBindGroupDescriptor scene_bind_group_descriptor = {};
         WGPUBindGroupDescriptor object_bind_group_descriptor = {};
@@ -61,8 +67,8 @@ namespace ghuva
 
     struct context
     {
-        using vertex_t = f32;
-        using index_t  = u16;
+        using vertex_t = mesh::vertex_t;
+        using index_t  = mesh::index_t;
 
         // Gets the singleton for this class.
         static auto get() -> context&;
@@ -118,9 +124,32 @@ namespace ghuva
         {
             alignas(64) ghuva::m4f transform;
         };
-        wgpu::Buffer object_uniform_buffer = {nullptr};
-        // You can have this many object_uniforms in object_uniform_buffer.
-        const ghuva::u32 object_uniform_limit = 100'000;
+        // The object_uniforms get split into chunks of object_chunk_limit (the last one can
+        // be smaller) so no single buffer goes over what the device can bind or allocate.
+        // Object i is at i % object_chunk_limit in chunk i / object_chunk_limit.
+        struct object_chunk
+        {
+            wgpu::Buffer buffer = {nullptr};
+            wgpu::BindGroup compute_bind_group = {nullptr}; // For the compute pass over this chunk.
+            ghuva::u64 capacity = 0; // In object_uniforms.
+        };
+        std::vector<object_chunk> object_chunks;
+        ghuva::u64 object_chunk_limit = 0; // Set from the device limits.
+        // Makes room for count object_uniforms, keeping the ones already there.
+        auto reserve_objects(ghuva::u64 count) -> void;
+
+        // The compute pass converts the objects in place, so it only goes over the ones that
+        // were just written, a range of them per dispatch. The range is read from
+        // compute_range_buffer at the dynamic offset given to setBindGroup(), up to
+        // max_compute_ranges of them compute_range_stride apart.
+        struct alignas(16) compute_range
+        {
+            ghuva::u32 first; // Within the chunk it's dispatched over.
+            ghuva::u32 count;
+        };
+        wgpu::Buffer compute_range_buffer = {nullptr};
+        ghuva::u64 compute_range_stride = 0; // Set from the device limits.
+        const ghuva::u64 max_compute_ranges = 1024;
         // And this is the stride of the elements.
         ghuva::u32 object_uniform_stride;
         ghuva::u32 compute_uniform_stride;
@@ -135,12 +164,42 @@ namespace ghuva
         wgpu::Buffer color_buffer = {nullptr};
         wgpu::Buffer normal_buffer = {nullptr};
         wgpu::Buffer index_buffer = {nullptr};
-        // The limits for these buffers
-        const ghuva::u64 vertex_count = 3'000'000;
-        const ghuva::u64 index_count  = 1'000'000;
-
-        // TODO: removeme!
-        wgpu::Buffer mapbuf = {nullptr};
+        // How many vertexes (in each of the vertex, color and normal buffers) and indexes fit.
+        ghuva::u64 vertex_capacity = 65'536;
+        ghuva::u64 index_capacity  = 131'072;
+        // Grow the buffers so at least count fit, keeping what's in them. False if that'd
+        // go over the device's maxBufferSize.
+        auto reserve_vertexes(ghuva::u64 count) -> bool;
+        auto reserve_indexes(ghuva::u64 count) -> bool;
+
+        // Buffers grow to at least twice their size so growing a bit at a time doesn't copy
+        // everything over and over. Every time one does it gets logged here.
+        struct buffer_growth
+        {
+            std::string label;
+            ghuva::u64 from; // In bytes.
+            ghuva::u64 to;
+            ghuva::u64 frame;
+        };
+        std::vector<buffer_growth> buffer_growths;
+
+        // Uploads through a ring of MapWrite | CopySrc buffers the CPU writes into directly,
+        // instead of writeBuffer() copying everything into the driver's own memory first:
+        //     auto const s = ctx.stage(size);           // s.data is mapped, write size bytes to it.
+        //     ctx.copy_staged(s, buffer, offset, size); // Records the copy.
+        //     ctx.submit_staged();                      // Before anything reads buffer.
+        // A slot gets written to again once the GPU is done copying out of it and it's mapped
+        // back, so the ring ends up about as big as the frames in flight.
+        struct staged
+        {
+            void* data;
+            wgpu::Buffer buffer; // Staging buffer data is in, at offset.
+            ghuva::u64 offset;
+        };
+        auto stage(ghuva::u64 size) -> staged; // Offsets within a slot are kept 64 byte aligned.
+        auto copy_staged(staged const& from, wgpu::Buffer to, ghuva::u64 to_offset, ghuva::u64 size) -> void; // size and to_offset in multiples of 4.
+        auto submit_staged() -> void;
+        const ghuva::u64 staging_slot_size = 4 * 1024 * 1024; // Smallest a slot gets, bigger if asked for more at once.
 
         // Write into the vertex buffers as needed, then
         // get your render_pass from begin_render().
@@ -168,7 +227,6 @@ namespace ghuva
         wgpu::PipelineLayout pipeline_layout = {nullptr};
         wgpu::BindGroup scene_bind_group = {nullptr};
         wgpu::BindGroup object_bind_group = {nullptr};
-        wgpu::BindGroup compute_bind_group = {nullptr};
 
         wgpu::SwapChain swapchain = {nullptr};
         wgpu::ComputePipeline compute_pipeline = {nullptr};
@@ -213,6 +271,29 @@ namespace ghuva
         auto init_compute_pipeline() -> void;
         auto init_textures() -> void;
 
+        // Swaps buffer for a bigger one made from desc, copying the contents over on the GPU.
+        auto grow_buffer(wgpu::Buffer& buffer, WGPUBufferDescriptor& desc, ghuva::u64 size) -> void;
+
+        struct staging_slot
+        {
+            enum class state_t : ghuva::u8 {
+                free,      // Mapped, nobody's using it.
+                writing,   // Mapped, being written to for the next submit_staged().
+                in_flight, // Unmapped, waiting for the copies out of it to be done and to be mapped back.
+            };
+
+            wgpu::Buffer buffer = {nullptr};
+            ghuva::u64 capacity = 0; // 0 if mapping it back failed, then it gets replaced.
+            ghuva::u64 used     = 0;
+            std::byte* mapped   = nullptr;
+            state_t state       = state_t::free;
+        };
+        std::vector< std::unique_ptr<staging_slot> > staging_slots; // Pointers stay put for the map callbacks.
+        std::vector<staging_slot*> staging_batch; // The ones being written, in order.
+        wgpu::CommandEncoder staging_encoder = {nullptr};
+
+        auto make_staging_slot(staging_slot& slot, ghuva::u64 capacity) -> void;
+
         // Wrappers around wgpu verbosity.
         auto create_wgsl_shader(std::string code, std::string label = "unnamed shader") -> wgpu::ShaderModule;
         auto create_bind_group_layout(
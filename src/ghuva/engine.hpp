@@ -1,16 +1,43 @@
 #pragma once
 
+#include "utils/job_pool.hpp"
+#include "utils/slot_map.hpp"
+#include "utils/radix_sort.hpp"
+#include "utils/binary_file.hpp"
+#include "utils/hash.hpp"
+#include "utils/inplace_function.hpp"
+#include "utils/mpsc_queue.hpp"
+#include "utils/seqlock_ring.hpp"
+#include "utils/trace.hpp"
 #include "utils/guarded.hpp"
 #include "utils/chrono.hpp"
 #include "utils/aliases.hpp"
 #include "utils/forward.hpp"
+#include "utils/cvt.hpp"
+#include "utils/math.hpp"
+#include "object_table.hpp"
+#include "perf_history.hpp"
 #include "object.hpp"
 #include "mesh.hpp"
 
 #include <shared_mutex>
+#include <functional>
+#include <algorithm>
+#include <atomic>
 #include <vector>
+#include <optional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <span>
+#include <array>
 #include <mutex>
 #include <tuple>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <cmath>
 
 #include <fmt/core.h>
 
@@ -59,6 +86,23 @@ namespace ghuva::impl
     >
     struct tlist_contains< TList<>, T> { static constexpr bool value = false; };
 
+    // Index, T has to be in there.
+    template <typename TList, typename T>
+    struct tlist_index;
+    template <
+        template <typename...> typename TList,
+        typename... Ts,
+        typename T
+    >
+    struct tlist_index< TList<T, Ts...>, T> { static constexpr u64 value = 0; };
+    template <
+        template <typename...> typename TList,
+        typename... Ts,
+        typename T,
+        typename T2
+    >
+    struct tlist_index< TList<T2, Ts...>, T> { static constexpr u64 value = 1 + tlist_index< TList<Ts...>, T >::value; };
+
     // Cond.
     template <bool B, typename T, typename T2> struct cond;
     template <        typename T, typename T2> struct cond<true, T, T2>  { using type = T; };
@@ -82,12 +126,11 @@ namespace ghuva
     template <typename T> struct is_event< event<T> > { static constexpr bool value = true; };
     template <typename T> constexpr auto is_event_v = is_event<T>::value;
 
-    // TODO: how do I make ordering for this deterministic ?
-    // NOTE: If parallel_ticking == false this will already be deterministic.
-    //       However, if parallel_ticking we want to have each thread have its own postboard
-    //       and at the end of ticking we merge them all sequentially.
-    //       Basically, tick in chunks, keep a chunk id, then order based on chunkid THEN messageid
-    //       and use that final ordering to produce the final id.
+    // NOTE: Messages (and events) sent while ticking go to the board of the chunk
+    //       of objects being ticked and only get their final id when the chunk boards
+    //       are merged, in chunk order. So ids follow object order no matter how
+    //       many threads did the ticking. The ones from outside go after them on
+    //       the boards, see drain_ingress().
     template <typename T>
     struct message
     {
@@ -97,12 +140,6 @@ namespace ghuva
         u64 source_object_id; // 0 = engine/external/unidentified events.
         u64 posted_at_tick;
         body_t body;
-
-    private:
-        // TODO: we can refactor this out of here probably.
-        //u64 chunk_id;
-        //u64 chunk_message_id;
-        //friend class engine;
     };
     template <typename T> struct is_message               { static constexpr bool value = false; };
     template <typename T> struct is_message< message<T> > { static constexpr bool value = true; };
@@ -134,6 +171,20 @@ namespace ghuva
 // Engine proper.
 namespace ghuva
 {
+    // Who runs the object ticks when parallel_ticking is on.
+    enum class tick_backend : u8
+    {
+        openmp,   // #pragma omp parallel for.
+        job_pool, // The engine's own work-stealing ghuva::job_pool.
+    };
+
+    // What tick() does with the time it couldn't catch up on once it hits max_ticks_per_call.
+    enum class overload_policy : u8
+    {
+        drop,  // Forget about it, the simulation slows down instead of spiraling.
+        carry, // Keep it for the next tick() calls, fine as long as the overload is temporary.
+    };
+
     struct engine_config
     {
         f32 leftover_tick_seconds = 0.0f;
@@ -144,10 +195,16 @@ namespace ghuva
         f32 total_time = 0.0f;
 
         bool parallel_ticking = true;
+        ghuva::tick_backend tick_backend = ghuva::tick_backend::job_pool;
+        u32 tick_workers = 0; // Threads used for parallel_ticking, 0 = std::thread::hardware_concurrency().
+
+        u32 max_ticks_per_call = 8; // Most fixed ticks a single tick() call runs, 0 = no limit.
+        ghuva::overload_policy overload_policy = ghuva::overload_policy::drop;
+
+        bool record_perf_history = true; // See engine::perf_history().
 
         u64 last_mesh_id = 1;
-        u64 last_object_id = 1;
-        u64 last_event_id = 1;
+        u64 last_event_id = 1;   // As of the start of the tick, ids are handed out atomically by the engine.
         u64 last_message_id = 1;
     };
 
@@ -155,48 +212,115 @@ namespace ghuva
     struct engine_perf
     {
         f32 fixed_tick; // Time for fixed_tick().
-        f32 commit; // Time it took to commit this snapshot.
+        f32 commit; // Time it took to commit the previous snapshot, this one
+                    // is already out there by the time we know how long it took.
 
         f32 copy_objects; // Time it takes to copy from last_snapshot.
+        u64 objects_copied; // How many objects actually needed copying.
+        u64 snapshots_pinned; // Retired snapshots that readers are still holding on to (the previous one always is).
 
         f32 engine_events; // Time it takes to handle all engine events.
+        f32 sort_messages; // Time it takes to sort the messageboard by target.
         // Event times.
+        f32 load_snapshot;
         f32 delete_objects;
         f32 register_objects;
         f32 register_meshes;
 
-        f32 object_ticks;
+        f32 object_ticks; // Includes diffing the objects against the previous snapshot.
+        u64 objects_changed; // Created or modified this tick, see snapshot::delta.
+
+        // Pacing, all of these are totals since the engine started.
+        u64 missed_deadlines; // Ticks that ran late because tick() had to catch up.
+        u64 overloads; // tick() calls that hit max_ticks_per_call.
+        f32 dropped_seconds; // Simulation time thrown away by overload_policy::drop.
+
+        // Per-worker breakdown of object_ticks, only filled in by tick_backend::job_pool.
+        static constexpr u64 max_tracked_workers = 64;
+        u32 tick_workers;
+        u64 tick_chunks;
+        std::array<f32, max_tracked_workers> worker_busy; // Time spent ticking objects.
+        std::array<f32, max_tracked_workers> worker_idle; // Time spent looking for work or waiting on the others.
     };
 
     template <typename ExtraPostboardEvents, typename Messages>
     struct engine
     {
-        using object_t = ghuva::object<engine>; // CRTP this bitch.
+        using object_t      = ghuva::object<engine>; // CRTP this bitch.
+        using object_ref_t  = ghuva::object_ref<engine>;
+        using object_cref_t = ghuva::object_ref<engine, true>;
+        using objects_view  = ghuva::objects_view;
+        using object_delta  = ghuva::object_delta;
+
+        struct snapshot;
+
+        // Ticks all the objects with object::system set to it in one go instead of calling their
+        // on_tick, gets them in contiguous runs (maybe many times per tick, from different threads).
+        // Whether objects with tick = false get skipped is up to the system.
+        using system_fn_t = ghuva::inplace_function<void(objects_view& objects, f32 dt, snapshot const& snapshot, engine& engine)>;
+        struct system
+        {
+            std::string name;
+            system_fn_t tick;
+        };
 
         // Some engine events.
-        struct register_mesh        { ghuva::mesh mesh; /* Id is overriden */ };
-        struct register_object      { object_t object; /* Id is overriden. */ };
-        struct delete_object        { u64 id; bool success; };
-        struct set_tps              { f32 tps; };
-        struct set_camera           { u64 object_id; };
-        struct set_time_multiplier  { f32 time_multiplier; };
-        struct set_parallel_ticking { bool parallel_ticking; };
-        using  e_register_mesh        = ghuva::event< register_mesh >;
-        using  e_register_object      = ghuva::event< register_object >;
-        using  e_delete_object        = ghuva::event< delete_object >;
-        using  e_set_tps              = ghuva::event< set_tps >;
-        using  e_set_camera           = ghuva::event< set_camera >;
-        using  e_set_time_multiplier  = ghuva::event< set_time_multiplier >;
-        using  e_set_parallel_ticking = ghuva::event< set_parallel_ticking >;
+        struct register_mesh           { ghuva::mesh mesh; /* Id is overriden */ };
+        struct register_object         { object_t object; /* Id is overriden. */ };
+        // Registers a bunch of copies of prototype at once, their ids are [first_id, first_id + count).
+        struct register_objects
+        {
+            object_t prototype; // Id is overriden.
+            u64 count = 0; // 0 = transforms.size().
+            std::vector<ghuva::transform> transforms = {}; // Optional, object i gets transforms[i].
+            // Optional, called with each object after the transform is set. May run on any thread.
+            std::function<void(u64 index, object_ref_t& object)> init = nullptr;
+            u64 first_id = 0; // Filled in by the engine.
+        };
+        struct delete_object           { u64 id; bool success; };
+        struct set_tps                 { f32 tps; };
+        struct set_camera              { u64 object_id; };
+        struct set_time_multiplier     { f32 time_multiplier; };
+        struct set_parallel_ticking    { bool parallel_ticking; };
+        struct set_tick_backend        { ghuva::tick_backend tick_backend; };
+        struct set_tick_workers        { u32 tick_workers; /* 0 = std::thread::hardware_concurrency() */ };
+        struct set_max_ticks_per_call  { u32 max_ticks_per_call; /* 0 = no limit */ };
+        struct set_overload_policy     { ghuva::overload_policy overload_policy; };
+        struct set_record_perf_history { bool record_perf_history; };
+        // Replaces the objects, meshes, camera, game time and how fast it goes with what save_snapshot()
+        // wrote to path. Systems are matched by name with the ones added so far, objects of missing
+        // ones end up in no system.
+        struct load_snapshot           { std::string path; bool success; };
+        using  e_register_mesh           = ghuva::event< register_mesh >;
+        using  e_register_object         = ghuva::event< register_object >;
+        using  e_register_objects        = ghuva::event< register_objects >;
+        using  e_delete_object           = ghuva::event< delete_object >;
+        using  e_set_tps                 = ghuva::event< set_tps >;
+        using  e_set_camera              = ghuva::event< set_camera >;
+        using  e_set_time_multiplier     = ghuva::event< set_time_multiplier >;
+        using  e_set_parallel_ticking    = ghuva::event< set_parallel_ticking >;
+        using  e_set_tick_backend        = ghuva::event< set_tick_backend >;
+        using  e_set_tick_workers        = ghuva::event< set_tick_workers >;
+        using  e_set_max_ticks_per_call  = ghuva::event< set_max_ticks_per_call >;
+        using  e_set_overload_policy     = ghuva::event< set_overload_policy >;
+        using  e_set_record_perf_history = ghuva::event< set_record_perf_history >;
+        using  e_load_snapshot           = ghuva::event< load_snapshot >;
 
         using default_events = impl::type_list<
             e_register_mesh,
             e_register_object,
+            e_register_objects,
             e_delete_object,
             e_set_tps,
             e_set_camera,
             e_set_time_multiplier,
-            e_set_parallel_ticking
+            e_set_parallel_ticking,
+            e_set_tick_backend,
+            e_set_tick_workers,
+            e_set_max_ticks_per_call,
+            e_set_overload_policy,
+            e_set_record_perf_history,
+            e_load_snapshot
         >;
         using extra_events   = ExtraPostboardEvents;
         using events         = impl::tlist_merge< default_events, extra_events >::type;
@@ -206,10 +330,20 @@ namespace ghuva
 
         struct snapshot
         {
-            u64 id;
-            u64 camera_object_id;
+            u64 id = 0;
+            u64 camera_object_id = 0;
+
+            ghuva::object_table<engine> objects;
+            std::vector<system> systems; // Index = system id - 1.
 
-            std::vector<object_t> objects;
+            // O(1) lookups by object id, nullopt/object_table::npos if there's no such object in this snapshot.
+            constexpr auto find(u64 object_id) const -> std::optional<object_cref_t> { return objects.find(object_id); }
+            constexpr auto index_of(u64 object_id) const -> u64 { return objects.index_of(object_id); }
+
+            // Hash of the state of the world: the hot state of every object (in order), the camera,
+            // the game time and which meshes there are. Equal checksums = both runs did the same
+            // thing, as far as anyone can see. Timings and boards are left out.
+            constexpr auto checksum() const -> u64;
 
             // Shorthand for checking all the vents of a given type on the postboard. Use like:
             //     snapshot.template on_post<my_event_type>([&, count = 0](my_event_type const& e){
@@ -222,8 +356,11 @@ namespace ghuva
             // Calls f with each std::vector<event> in the postboard.
             template <typename F> constexpr auto all_posts(F&& f) const -> snapshot const&;
 
+            // The messages of type M sent to self, in the order they were sent. Use like:
+            //     for(auto const& m : snapshot.template read_messages<my_message_type>(self))
+            //         fmt::print("Got {} from {}", m.body.stuff, m.source_object_id);
             // Since objects only see other object as const& they can only call this on theirselves.
-            // constexpr auto read_messages(object&, F&&);
+            template <typename M> constexpr auto read_messages(object_ref_t& self) const -> std::span< ghuva::message<M> const >;
 
             // General events acessible to all objects are posted
             // to the postboard, it's up to each object to check
@@ -235,6 +372,12 @@ namespace ghuva
             ghuva::engine_perf   engine_perf;
 
             std::vector<mesh> meshes;
+            u64 meshes_changed_at  = 0; // Id of the snapshot the mesh set last changed in.
+            u64 meshes_replaced_at = 0; // Same, for the last time all of it got replaced (loaded), so ids may now be for other meshes.
+
+            // How the objects changed since the previous snapshot. Use engine::delta_between()
+            // to catch up from older ones.
+            std::shared_ptr<ghuva::object_delta const> delta = std::make_shared<ghuva::object_delta const>();
 
         private:
             // Messages are private, no looksies.
@@ -250,25 +393,174 @@ namespace ghuva
             friend class engine;
         };
 
-        constexpr auto take_snapshot() -> snapshot;
+        // Committed snapshots are immutable and shared, holding on to a handle keeps
+        // that snapshot alive for as long as you need it without copying anything.
+        // The engine only reuses a snapshot's memory after every handle to it is gone.
+        using snapshot_handle = std::shared_ptr<snapshot const>;
+
+        constexpr auto take_snapshot() const -> snapshot_handle;
+
+        // For drawing in between ticks: the last two committed snapshots and how far real time
+        // has gotten from previous to current, 0 to 1. Blend previous into current by alpha
+        // and motion looks smooth no matter how low ticks_per_second is, at the cost of
+        // showing things one tick late.
+        struct snapshot_pair
+        {
+            snapshot_handle previous;
+            snapshot_handle current;
+            f32 alpha = 1.0f;
+        };
+        constexpr auto take_snapshot_pair() const -> snapshot_pair;
+
+        // Everything that changed from snapshot from_id to snapshot to_id, so keeping a copy of the
+        // objects up to date is O(changes). nullopt if that's too far back (or ahead), start over then.
+        constexpr auto delta_between(u64 from_id, u64 to_id) const -> std::optional<object_delta>;
+
+        // Writes the objects, meshes, camera and config of s to path, for loading it back later with
+        // a load_snapshot event. on_tick can't be saved, objects that need to do something after
+        // being loaded should use a system. Snapshots are immutable, so this is fine to run on any
+        // thread with a handle from take_snapshot(). False if writing failed.
+        static constexpr auto save_snapshot(snapshot const& s, std::string const& path) -> bool;
+
+        // The perf of the last count ticks (at most perf_history_size), oldest first. Any thread can
+        // call this whenever, the engine never waits on it. Ticks with record_perf_history off
+        // aren't in there. See perf_history.hpp for percentiles and dumping it to CSV/JSON.
+        constexpr auto perf_history(u64 count = perf_history_size) const -> std::vector<ghuva::perf_record>;
+        static constexpr u64 perf_history_size = 4096;
+
+        // Bump whenever what save_snapshot() writes changes.
+        static constexpr u32 snapshot_file_version = 2;
+        static constexpr u64 snapshot_file_magic   = 0x706e'7361'7675'6867; // "ghuvasnp" on disk.
+        // Runs however many fixed ticks real_dt is worth, at most engine_config::max_ticks_per_call.
+        // Returns how many it ran.
         constexpr auto tick(f32 real_dt) -> u64;
+        // Ticks until keep_going() returns false, sleeping in between so each fixed tick
+        // happens when it is due instead of busy looping. The last spin_seconds before
+        // each tick are spent spinning since sleeps tend to overshoot.
+        template <typename F>
+        constexpr auto run(F&& keep_going, f32 spin_seconds = 0.001f) -> void;
+        // Runs exactly one fixed tick, however much time went by. For driving the engine headlessly.
+        constexpr auto step() -> void;
+
+        // Returns the id of the new system, set it as object::system for it to tick those objects.
+        // Takes effect on the next tick.
+        constexpr auto add_system(std::string name, system_fn_t tick) -> u64;
+
+        // Returned by post() and message() when called from inside on_tick,
+        // the real id is only assigned once the tick is over.
+        static constexpr u64 deferred_id = ~0_u64;
 
         // Posts events to the next snapshot's postboard. Returns the event id.
         // Remember that an id = 0 means failed.
         template <typename E>
         constexpr auto post(E&& event, u64 source_id = 0) -> u64;
-        // TODO: Sends a direct event to the object for next snapshot.
+        // Sends a direct message to the object, it gets to read it next snapshot. Returns the message id.
         template <typename E>
         constexpr auto message(E&& event, u64 target_id, u64 source_id = 0) -> u64;
 
+        // Everything that can be posted or messaged from outside a tick, kind = index in here.
+        using ingress_types  = impl::tlist_merge< events, messages >::type;
+        // Gets each event<T> or message<T> posted from outside a tick as it lands on the boards of
+        // snapshot tick, in id order. Runs on whatever thread is ticking, keep it quick.
+        using ingress_hook_t = std::function<void(u64 tick, u64 kind, void const* e)>;
+        // Only what gets posted after this call goes through hook, nullptr stops it. See ghuva::event_recorder.
+        constexpr auto set_ingress_hook(ingress_hook_t hook) -> void;
+
     private:
-        // TODO: snapshot keepalive system ?
-        guarded<snapshot> last_snapshot;
+        // Only ever locked to swap or copy the pointer.
+        struct published_t
+        {
+            std::shared_ptr<snapshot> current  = std::make_shared<snapshot>();
+            std::shared_ptr<snapshot> previous = current;
+            // Game time since current, as of when tick() last returned. For take_snapshot_pair().
+            f32 leftover_tick_seconds = 0.0f;
+            std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now();
+            // The deltas of the last few snapshots, oldest first. For delta_between().
+            std::vector< std::shared_ptr<ghuva::object_delta const> > deltas;
+        };
+        static constexpr u64 max_delta_history = 8;
+        guarded<published_t> last_snapshot;
         guarded<snapshot> partial_snapshot; // Postboard of this one and
                                             // other stuff are filled in
                                             // as we tick the current snapshot.
 
+        // Posts and messages from outside of the ticks land here, without taking any locks,
+        // and get moved onto the next snapshot's boards at the start of each tick.
+        template <typename... Ts>
+        struct ingress_t
+        {
+            template <typename T>
+            constexpr auto get() -> ghuva::mpsc_queue<T>& { return std::get< ghuva::mpsc_queue<T> >(queues); }
+
+            std::tuple< ghuva::mpsc_queue<Ts>... > queues;
+        };
+        impl::tlist_extract< events,   ingress_t >::type post_ingress;
+        impl::tlist_extract< messages, ingress_t >::type message_ingress;
+        std::atomic<u64> next_event_id   = 1;
+        std::atomic<u64> next_message_id = 1;
+        std::atomic<u64> committed_id    = 0; // For posted_at_tick, so posting doesn't need last_snapshot's lock.
+        // Only touched with partial_snapshot locked.
+        ingress_hook_t ingress_hook;
+        u64 hook_first_event_id   = 0;
+        u64 hook_first_message_id = 0;
+
+        // Posts and messages made while ticking a chunk of objects, id = order within the chunk.
+        struct chunk_board
+        {
+            postboard_t    postboard;
+            messageboard_t messageboard;
+            u64 events   = 0;
+            u64 messages = 0;
+            std::vector<ghuva::object_change> changed; // The chunk's part of snapshot::delta.
+            std::vector<u64>                  ticked;  // Same.
+        };
+        // Set while a thread is ticking a chunk so post() and message() can skip the locks.
+        struct ticking_context
+        {
+            engine*      owner          = nullptr;
+            chunk_board* board          = nullptr;
+            u64          posted_at_tick = 0;
+        };
+        static inline thread_local ticking_context ticking = {};
+
+        // Only touched from fixed_tick(), which is never run concurrently.
+        std::shared_ptr<snapshot> committed = last_snapshot.read([](auto const& l){ return l.current; });
+        std::vector< std::shared_ptr<snapshot> > retired; // Previously committed, oldest first. Recycled
+                                                          // as the next one to tick once nobody holds them.
+        static constexpr u64 max_retired = 4;
+        f32 last_commit_seconds = 0.0f;
+        ghuva::seqlock_ring<ghuva::perf_record> perf_ring{ perf_history_size }; // Pushed to by fixed_tick() only.
+
+        // Only touched by tick(), stamped into engine_perf by fixed_tick().
+        f32 pending_seconds  = 0.0f; // leftover_tick_seconds as of the end of the last tick().
+        u64 missed_deadlines = 0;
+        u64 overloads        = 0;
+        f32 dropped_seconds  = 0.0f;
+        std::unique_ptr<ghuva::job_pool> tick_pool;
+        ghuva::job_pool::grain           tick_grain;
+        ghuva::job_pool::grain           spawn_grain;
+        messageboard_t                   message_scratch; // Reused by sort_messages().
+        std::vector<ghuva::radix_item>   sort_items, sort_scratch;
+        std::vector<chunk_board>         chunk_boards;
+        std::vector<u64>                 deleted_ids; // This tick's, for snapshot::delta.
+        std::vector< std::shared_ptr<object_delta> > deltas; // Recycled like the snapshots, they can get big.
+        static constexpr u64 max_deltas = max_delta_history + max_retired + 4;
+        std::vector<object_delta const*> catch_up_deltas; // Scratch for catch_up().
+
         constexpr auto fixed_tick(f32 dt) -> void;
+        constexpr auto recycle() -> std::shared_ptr<snapshot>;
+        constexpr auto commit(std::shared_ptr<snapshot> s) -> void;
+        constexpr auto record_perf(snapshot const& s) -> void;
+        constexpr auto catch_up(snapshot& to, snapshot const& from) -> void;
+        constexpr auto pool(engine_config const& config) -> ghuva::job_pool&;
+        constexpr auto spawn_objects(snapshot& s, register_objects& r) -> void;
+        constexpr auto sort_messages(snapshot& s) -> void;
+        constexpr auto tick_objects(snapshot& s, f32 dt) -> void;
+        constexpr auto tick_chunk(snapshot& s, f32 dt, chunk_board& board, u64 begin, u64 end) -> void;
+        constexpr auto merge_chunk_boards(u64 chunk_count) -> void;
+        constexpr auto collect_delta(snapshot& s, u64 chunk_count) -> void;
+        constexpr auto load_snapshot_file(snapshot& s, std::string const& path) -> bool;
+        constexpr auto drain_ingress(snapshot& s) -> void;
     };
 
     using default_engine = engine< impl::type_list<>, impl::type_list<> >;
@@ -277,41 +569,114 @@ namespace ghuva
 // Impls.
 
 template <typename T, typename T2>
-constexpr auto ghuva::engine<T, T2>::take_snapshot() -> snapshot
+constexpr auto ghuva::engine<T, T2>::take_snapshot() const -> snapshot_handle
 {
-    snapshot temp;
+    return last_snapshot.read([](auto const& l) -> snapshot_handle { return l.current; });
+}
 
-    last_snapshot.read([&](auto const& s){
-        temp = s;
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::take_snapshot_pair() const -> snapshot_pair
+{
+    auto pair = snapshot_pair{};
+    f32 leftover_tick_seconds;
+    std::chrono::steady_clock::time_point at;
+    last_snapshot.read([&](auto const& l){
+        pair.previous         = l.previous;
+        pair.current          = l.current;
+        leftover_tick_seconds = l.leftover_tick_seconds;
+        at                    = l.at;
     });
 
-    return temp;
+    // Whatever real time went by since then counts too, otherwise alpha would
+    // sit still while the engine thread sleeps until the next tick.
+    auto const& config  = pair.current->engine_config;
+    auto const  elapsed = std::chrono::duration<f32>(std::chrono::steady_clock::now() - at).count();
+    pair.alpha = ghuva::m::clamp((leftover_tick_seconds + elapsed * config.time_multiplier) * config.ticks_per_second, 0.0f, 1.0f);
+    return pair;
+}
+
+// Folds the per-tick deltas in order: later values win, the change bits add up and whatever
+// got created and deleted in between never happened as far as the caller is concerned.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::delta_between(u64 from_id, u64 to_id) const -> std::optional<object_delta>
+{
+    if(from_id == to_id) return object_delta{ .from = from_id, .to = to_id };
+    if(from_id > to_id)  return std::nullopt;
+
+    auto steps = std::vector< std::shared_ptr<object_delta const> >{};
+    last_snapshot.read([&](auto const& l){
+        for(auto const& d : l.deltas) if(d->from >= from_id && d->to <= to_id) steps.push_back(d);
+    });
+    if(steps.empty() || steps.front()->from != from_id || steps.back()->to != to_id) return std::nullopt;
+    if(steps.size() == 1) return *steps.front();
+
+    auto result = object_delta{ .from = from_id, .to = to_id };
+    auto index  = std::unordered_map<u64, u64>{}; // Object id -> where it is in result.changed.
+    for(auto const& step : steps)
+    {
+        for(auto const& c : step->changed)
+        {
+            auto const [it, fresh] = index.try_emplace(c.id, result.changed.size());
+            if(fresh) { result.changed.push_back(c); continue; }
+
+            auto& into = result.changed[it->second];
+            auto const what = into.what | c.what;
+            into      = c;
+            into.what = what;
+        }
+        for(auto const id : step->deleted)
+        {
+            auto const it = index.find(id);
+            if(it == index.end()) { result.deleted.push_back(id); continue; }
+
+            auto& c = result.changed[it->second];
+            if(!(c.what & ghuva::object_change::created)) result.deleted.push_back(id);
+            c.what = 0; // Ids are never reused, so it can't come back.
+            index.erase(it);
+        }
+    }
+
+    std::erase_if(result.changed, [](auto const& c){ return c.what == 0; });
+    std::sort(result.changed.begin(), result.changed.end(), [](auto const& a, auto const& b){ return a.id < b.id; });
+    std::sort(result.deleted.begin(), result.deleted.end());
+    return result;
 }
 
 template <typename T, typename T2>
 constexpr auto ghuva::engine<T, T2>::tick(f32 real_dt) -> u64
 {
-    f32 dt;
+    GHUVA_TRACE_ZONE("engine::tick");
     f32 leftover_tick_seconds;
 
     partial_snapshot.write([&](auto& p) {
-        dt = real_dt * p.engine_config.time_multiplier;
-        p.engine_config.leftover_tick_seconds += dt;
+        p.engine_config.leftover_tick_seconds += real_dt * p.engine_config.time_multiplier;
         leftover_tick_seconds = p.engine_config.leftover_tick_seconds;
     });
 
-    u64 start_tick;
-    last_snapshot.read([&](auto const& l){
-        start_tick = l.id;
-    });
+    auto const start_tick = committed->id;
 
-    while(true)
+    for(auto ticks = 0_u64; ; ++ticks)
     {
-        auto seconds_per_tick = last_snapshot.read([&](auto const& l){
-            return 1.0f / l.engine_config.ticks_per_second;
-        });
+        auto const& config = committed->engine_config; // fixed_tick() replaces committed.
+        auto const seconds_per_tick = 1.0f / config.ticks_per_second;
         if(leftover_tick_seconds < seconds_per_tick) break;
 
+        if(config.max_ticks_per_call != 0 && ticks == config.max_ticks_per_call)
+        {
+            ++overloads;
+            if(config.overload_policy == ghuva::overload_policy::carry) break;
+
+            // Only whole ticks go, the fraction still counts towards the next one.
+            auto const dropped = leftover_tick_seconds - std::fmod(leftover_tick_seconds, seconds_per_tick);
+            partial_snapshot.write([&](auto& p){
+                p.engine_config.leftover_tick_seconds -= dropped;
+            });
+            leftover_tick_seconds -= dropped;
+            dropped_seconds       += dropped;
+            break;
+        }
+        if(ticks > 0) ++missed_deadlines;
+
         this->fixed_tick(seconds_per_tick);
 
         partial_snapshot.write([&](auto& p){
@@ -320,120 +685,562 @@ constexpr auto ghuva::engine<T, T2>::tick(f32 real_dt) -> u64
         leftover_tick_seconds -= seconds_per_tick;
     }
 
-    u64 last_id;
-    last_snapshot.read([&](auto const& l){
-        last_id = l.id;
+    pending_seconds = leftover_tick_seconds;
+    last_snapshot.write([&](auto& l){
+        l.leftover_tick_seconds = leftover_tick_seconds;
+        l.at                    = std::chrono::steady_clock::now();
     });
-    return last_id - start_tick;
+    return committed->id - start_tick;
+}
+
+template <typename T, typename T2>
+template <typename F>
+constexpr auto ghuva::engine<T, T2>::run(F&& keep_going, f32 spin_seconds) -> void
+{
+    using clock = std::chrono::steady_clock;
+    using secs  = std::chrono::duration<f32>;
+
+    auto last = clock::now();
+    while(keep_going())
+    {
+        auto const& config          = committed->engine_config;
+        auto const seconds_per_tick = 1.0f / config.ticks_per_second;
+
+        // Real time until the next tick is due. Capped so a paused (or very slowed
+        // down) engine still gets to notice keep_going() and config changes.
+        auto wait = 0.1f;
+        if(config.time_multiplier > 0.0f)
+            wait = std::clamp((seconds_per_tick - pending_seconds) / config.time_multiplier, 0.0f, 0.1f);
+
+        // Sleeping is coarse so stop a bit early and spin the rest of the way.
+        auto const deadline = last + std::chrono::duration_cast<clock::duration>(secs{ wait });
+        auto const wake_up  = deadline - std::chrono::duration_cast<clock::duration>(secs{ spin_seconds });
+        if(clock::now() < wake_up) std::this_thread::sleep_until(wake_up);
+        while(clock::now() < deadline) std::this_thread::yield();
+
+        auto const now = clock::now();
+        this->tick(std::chrono::duration_cast<secs>(now - last).count());
+        last = now;
+    }
+}
+
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::step() -> void
+{
+    this->fixed_tick(1.0f / committed->engine_config.ticks_per_second);
 }
 
 template <typename T, typename T2>
 constexpr auto ghuva::engine<T, T2>::fixed_tick(f32 dt) -> void
 {
+    GHUVA_TRACE_ZONE("engine::fixed_tick");
     auto fixed_tick_stopwatch = ghuva::chrono::stopwatch();
-    f32 copy_objects_time;
 
-    u64                   last_snapshot_id;
-    std::vector<object_t> last_snapshot_objects;
-    u64                   last_snapshot_camera_object_id;
-    f32                   last_snapshot_total_time;
-    std::vector<mesh>     last_snapshot_meshes;
+    // We tick into a recycled snapshot, so first bring it up to date with the last one.
+    auto  w_ptr = this->recycle();
+    auto& w     = *w_ptr;
+    w.engine_perf.snapshots_pinned = std::count_if(retired.begin(), retired.end(), [](auto const& r){ return r.use_count() != 1; });
+    auto const& l = *committed;
+    w.engine_perf.copy_objects = ghuva::chrono::time([&]{ catch_up(w, l); });
+    w.id                       = l.id + 1;
+    w.camera_object_id         = l.camera_object_id;
+    w.engine_config.total_time = l.engine_config.total_time + dt;
+    w.engine_perf.commit       = last_commit_seconds;
+    w.engine_perf.missed_deadlines = missed_deadlines;
+    w.engine_perf.overloads        = overloads;
+    w.engine_perf.dropped_seconds  = dropped_seconds;
 
-    last_snapshot.read([&](auto const& l){
-        last_snapshot_id          = l.id;
-        copy_objects_time = ghuva::chrono::time([&]{
-            last_snapshot_objects = l.objects;
-        });
-        last_snapshot_camera_object_id = l.camera_object_id;
-        last_snapshot_total_time       = l.engine_config.total_time;
-        last_snapshot_meshes           = l.meshes;
-    });
+    partial_snapshot.write([&](auto& p){
+        auto const total_time = w.engine_config.total_time;
+        w.engine_config            = p.engine_config;
+        w.engine_config.total_time = total_time;
 
-    snapshot temp; // Used just before ticking.
+        // Swap the boards so p gets to reuse the memory of the old ones.
+        std::swap(w.postboard,    p.postboard);
+        std::swap(w.messageboard, p.messageboard);
+        std::apply([](auto&... regions){ (..., regions.clear()); }, p.postboard.regions);
+        std::apply([](auto&... regions){ (..., regions.clear()); }, p.messageboard.regions);
+        this->drain_ingress(w);
 
-    partial_snapshot.write([&](auto& p){
-        p.engine_config.total_time = last_snapshot_total_time + dt;
-        p.id                       = last_snapshot_id + 1;
-        p.engine_perf.copy_objects = copy_objects_time + ghuva::chrono::time([&]{
-            p.objects              = ghuva::move(last_snapshot_objects);
-        });
-        p.camera_object_id         = last_snapshot_camera_object_id;
-        p.meshes                   = ghuva::move(last_snapshot_meshes);
+        // Systems only ever get added.
+        if(w.systems.size() != p.systems.size()) w.systems = p.systems;
+        w.objects.set_group_count(w.systems.size() + 1);
 
         // Run the engine event handlers.
+        GHUVA_TRACE_ZONE("engine::events");
         auto engine_events_stopwatch = ghuva::chrono::stopwatch();
-        p.engine_perf.delete_objects = ghuva::chrono::time([&]{
-            p.template on_post<e_delete_object>([&](auto& e){
-                auto& objs = p.objects;
-                auto  pos  = std::find_if(objs.begin(), objs.end(), [&](auto obj){ return obj.id == e.body.id; });
-
-                if(pos != objs.end())
-                {
-                    e.body.success = true;
-                    objs.erase(pos); // TODO: replace object vector with something else so can delete without relocating everything.
-                }
-                else { e.body.success = false; }
+        w.engine_perf.load_snapshot = ghuva::chrono::time([&]{
+            w.template on_post<e_load_snapshot>([&](auto& e){
+                e.body.success = this->load_snapshot_file(w, e.body.path);
             });
         });
-        p.engine_perf.register_objects = ghuva::chrono::time([&]{
-            p.template on_post<e_register_object>([&](auto& e){
+        w.engine_perf.delete_objects = ghuva::chrono::time([&]{
+            w.template on_post<e_delete_object>([&](auto& e){
+                e.body.success = w.objects.erase(e.body.id);
+                if(e.body.success) deleted_ids.push_back(e.body.id);
+            });
+        });
+        w.engine_perf.register_objects = ghuva::chrono::time([&]{
+            w.template on_post<e_register_object>([&](auto& e){
                 auto& o = e.body.object;
-                o.id = p.engine_config.last_object_id++;
-                p.objects.push_back(o);
+                o.touched_at = w.id;
+                o.id = w.objects.insert(o);
             });
+            w.template on_post<e_register_objects>([&](auto& e){ this->spawn_objects(w, e.body); });
         });
-        p.engine_perf.register_meshes = ghuva::chrono::time([&]{
-            p.template on_post<e_register_mesh>([&](auto& e){
+        w.engine_perf.register_meshes = ghuva::chrono::time([&]{
+            w.template on_post<e_register_mesh>([&](auto& e){
                 auto& m = e.body.mesh;
-                m.id = p.engine_config.last_mesh_id++;
-                p.meshes.push_back(m);
+                m.id = w.engine_config.last_mesh_id++;
+                w.meshes.push_back(m);
+                w.meshes_changed_at = w.id;
             });
         });
-        p.template on_post<e_set_tps>([&](auto& e){
-            p.engine_config.ticks_per_second = e.body.tps;
+        w.template on_post<e_set_tps>([&](auto& e){
+            w.engine_config.ticks_per_second = e.body.tps;
         });
-        p.template on_post<e_set_camera>([&](auto& e){
-            p.camera_object_id = e.body.object_id;
+        w.template on_post<e_set_camera>([&](auto& e){
+            w.camera_object_id = e.body.object_id;
         });
-        p.template on_post<e_set_time_multiplier>([&](auto& e){
-            p.engine_config.time_multiplier = e.body.time_multiplier;
+        w.template on_post<e_set_time_multiplier>([&](auto& e){
+            w.engine_config.time_multiplier = e.body.time_multiplier;
         });
-        p.template on_post<e_set_parallel_ticking>([&](auto& e){
-            p.engine_config.parallel_ticking = e.body.parallel_ticking;
+        w.template on_post<e_set_parallel_ticking>([&](auto& e){
+            w.engine_config.parallel_ticking = e.body.parallel_ticking;
         });
-        p.engine_perf.engine_events = engine_events_stopwatch.click().last_segment();
-
-        // TODO: order messages by receiver_object_id before ticking for easier message vector management.
-        //p.messageboard;
+        w.template on_post<e_set_tick_backend>([&](auto& e){
+            w.engine_config.tick_backend = e.body.tick_backend;
+        });
+        w.template on_post<e_set_tick_workers>([&](auto& e){
+            w.engine_config.tick_workers = e.body.tick_workers;
+        });
+        w.template on_post<e_set_max_ticks_per_call>([&](auto& e){
+            w.engine_config.max_ticks_per_call = e.body.max_ticks_per_call;
+        });
+        w.template on_post<e_set_overload_policy>([&](auto& e){
+            w.engine_config.overload_policy = e.body.overload_policy;
+        });
+        w.template on_post<e_set_record_perf_history>([&](auto& e){
+            w.engine_config.record_perf_history = e.body.record_perf_history;
+        });
+        w.engine_perf.engine_events = engine_events_stopwatch.click().last_segment();
 
-        temp = ghuva::move(p);
-        p = snapshot{};
-        p.engine_config = temp.engine_config;
+        p.engine_config = w.engine_config;
     });
 
+    // Give every object its own contiguous inbox.
+    w.engine_perf.sort_messages = ghuva::chrono::time([&]{ this->sort_messages(w); });
+
     // Do the tick proper.
-    temp.engine_perf.object_ticks = ghuva::chrono::time([&]{
-        // TODO: omp overhead too big. Threadpool with batching ?
-        if(temp.engine_config.parallel_ticking)
+    this->tick_objects(w, dt);
+
+    // Then set this snapshot in stone.
+    w.engine_perf.fixed_tick = fixed_tick_stopwatch.click().last_segment();
+    this->commit(ghuva::move(w_ptr));
+
+    if(committed->engine_config.record_perf_history) this->record_perf(*committed);
+}
+
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::record_perf(snapshot const& s) -> void
+{
+    constexpr auto count = [](auto const& board){
+        return std::apply([](auto const&... regions){ return (0_u64 + ... + regions.size()); }, board.regions);
+    };
+
+    auto const& p = s.engine_perf;
+    perf_ring.push({
+        .tick             = s.id,
+        .objects          = s.objects.size(),
+        .objects_copied   = p.objects_copied,
+        .objects_changed  = p.objects_changed,
+        .events           = count(s.postboard),
+        .messages         = count(s.messageboard),
+        .fixed_tick       = p.fixed_tick,
+        .commit           = last_commit_seconds,
+        .copy_objects     = p.copy_objects,
+        .engine_events    = p.engine_events,
+        .sort_messages    = p.sort_messages,
+        .load_snapshot    = p.load_snapshot,
+        .delete_objects   = p.delete_objects,
+        .register_objects = p.register_objects,
+        .register_meshes  = p.register_meshes,
+        .object_ticks     = p.object_ticks,
+    });
+}
+
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::perf_history(u64 count) const -> std::vector<ghuva::perf_record>
+{
+    auto records = std::vector<ghuva::perf_record>{};
+    records.reserve(std::min(count, perf_history_size));
+    perf_ring.read_latest(count, records);
+    return records;
+}
+
+// Newest first, it has the least catching up to do. If readers are
+// holding on to all of them we just start over with a fresh one.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::recycle() -> std::shared_ptr<snapshot>
+{
+    for(auto it = retired.rbegin(); it != retired.rend(); ++it)
+    {
+        if(it->use_count() != 1) continue;
+
+        // Pairs with the release in the readers' shared_ptr destructors.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto s = ghuva::move(*it);
+        retired.erase(std::next(it).base());
+        return s;
+    }
+    return std::make_shared<snapshot>();
+}
+
+// Publishing is just a pointer swap. The previous snapshot gets retired, and if
+// there are too many of those the oldest is dropped, whoever holds it last frees it.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::commit(std::shared_ptr<snapshot> s) -> void
+{
+    GHUVA_TRACE_ZONE("engine::commit");
+    auto const stopwatch = ghuva::chrono::stopwatch();
+
+    auto previous = ghuva::move(committed);
+    committed = ghuva::move(s);
+    last_snapshot.write([&](auto& l){
+        l.previous = ghuva::move(l.current);
+        l.current  = committed;
+
+        if(l.deltas.size() == max_delta_history) l.deltas.erase(l.deltas.begin());
+        l.deltas.push_back(committed->delta);
+    });
+    committed_id.store(committed->id, std::memory_order_release);
+
+    retired.push_back(ghuva::move(previous));
+    if(retired.size() > max_retired) retired.erase(retired.begin());
+
+    last_commit_seconds = stopwatch.since_beginning();
+}
+
+// Copies whatever changed in from since to was committed. Objects are skipped if they
+// sit at the same index in both and haven't been touched after to.id, and if the deltas
+// in between are still around only the objects they mention get looked at.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::catch_up(snapshot& to, snapshot const& from) -> void
+{
+    GHUVA_TRACE_ZONE("engine::catch_up");
+    auto const since = to.id;
+
+    // We're the only ones adding to the history, so these stay put after reading them.
+    catch_up_deltas.clear();
+    last_snapshot.read([&](auto const& l){
+        for(auto const& d : l.deltas) if(d->from >= since && d->to <= from.id) catch_up_deltas.push_back(d.get());
+    });
+    auto const chained = !catch_up_deltas.empty() && catch_up_deltas.front()->from == since && catch_up_deltas.back()->to == from.id;
+
+    to.engine_perf.objects_copied = to.objects.catch_up(
+        from.objects,
+        [&](u64 touched_at){ return touched_at > since; },
+        chained ? std::optional{ std::span<object_delta const* const>(catch_up_deltas) } : std::nullopt
+    );
+
+    if(from.meshes_changed_at > since) to.meshes = from.meshes;
+    to.meshes_changed_at  = from.meshes_changed_at;
+    to.meshes_replaced_at = from.meshes_replaced_at;
+}
+
+// Stable, so each object's messages stay in the order they were sent.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::sort_messages(snapshot& s) -> void
+{
+    GHUVA_TRACE_ZONE("engine::sort_messages");
+    constexpr auto by_target = [](auto const& a, auto const& b){ return a.target_object_id < b.target_object_id; };
+
+    std::apply([&](auto&... regions){
+        (..., [&](auto& region){
+            if(std::is_sorted(region.begin(), region.end(), by_target)) return;
+
+            sort_items.clear();
+            sort_items.reserve(region.size());
+            for(auto i = 0_u64; i < region.size(); ++i) sort_items.push_back({ .key = region[i].target_object_id, .index = i });
+
+            auto* pool = s.engine_config.parallel_ticking && region.size() > 16'384 ? &this->pool(s.engine_config) : nullptr;
+            ghuva::radix_sort(sort_items, sort_scratch, pool);
+
+            using el_t  = ghuva::remove_cvref_t< decltype(region) >::value_type;
+            auto& moved = message_scratch.template get<el_t>();
+            moved.clear();
+            moved.reserve(region.size());
+            for(auto const& it : sort_items) moved.push_back(ghuva::move(region[it.index]));
+            region.swap(moved);
+        }(regions));
+    }, s.messageboard.regions);
+}
+
+// (Re)spawns the workers if the requested amount changed.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::pool(engine_config const& config) -> ghuva::job_pool&
+{
+    auto const wanted = config.tick_workers != 0 ? config.tick_workers : std::max(1u, std::thread::hardware_concurrency());
+    if(!tick_pool || tick_pool->worker_count() != wanted)
+        tick_pool = std::make_unique<ghuva::job_pool>(wanted);
+    return *tick_pool;
+}
+
+// The copies are made in one go at the end of the objects, then init'd in parallel.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::spawn_objects(snapshot& s, register_objects& r) -> void
+{
+    GHUVA_TRACE_ZONE("engine::spawn_objects");
+    auto const count = r.count != 0 ? r.count : r.transforms.size();
+    r.prototype.touched_at = s.id;
+    r.first_id = s.objects.append(count, r.prototype);
+
+    auto const transforms = s.objects.transforms();
+    for(auto i = 0_u64; i < std::min(count, r.transforms.size() * cvt::to<u64>); ++i)
+        transforms[s.objects.index_of(r.first_id + i)] = r.transforms[i];
+    if(!r.init) return;
+
+    auto const init = [&](u64 begin, u64 end){
+        for(auto i = begin; i < end; ++i)
+        {
+            auto o = s.objects[s.objects.index_of(r.first_id + i)];
+            r.init(i, o);
+        }
+    };
+
+    if(s.engine_config.parallel_ticking && count > spawn_grain.min_chunk)
+        this->pool(s.engine_config).parallel_for(count, spawn_grain, [&](u64, u64 begin, u64 end, u32){ init(begin, end); });
+    else
+        init(0, count);
+}
+
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::tick_objects(snapshot& s, f32 dt) -> void
+{
+    GHUVA_TRACE_ZONE("engine::tick_objects");
+    auto& config = s.engine_config;
+    auto& perf   = s.engine_perf;
+    perf.tick_workers = 0;
+    perf.tick_chunks  = 0;
+
+    auto const stopwatch = ghuva::chrono::stopwatch();
+    auto const count     = s.objects.size() * cvt::to<u64>;
+    auto chunk_count     = 0_u64;
+    if(!config.parallel_ticking)
+    {
+        chunk_count = 1;
+        if(chunk_boards.size() < chunk_count) chunk_boards.resize(chunk_count);
+        tick_chunk(s, dt, chunk_boards[0], 0, count);
+    }
+    else if(config.tick_backend == tick_backend::openmp)
+    {
+        auto const workers    = config.tick_workers != 0 ? config.tick_workers * cvt::to<int> : omp_get_max_threads();
+        auto const chunk_size = std::max<u64>(16, count / (workers * 4_u64));
+        chunk_count = (count + chunk_size - 1) / chunk_size;
+        if(chunk_boards.size() < chunk_count) chunk_boards.resize(chunk_count);
+
+        #pragma omp parallel for num_threads(workers) schedule(static)
+        for(auto c = 0_u64; c < chunk_count; ++c)
+            tick_chunk(s, dt, chunk_boards[c], c * chunk_size, std::min(count, (c + 1) * chunk_size));
+    }
+    else
+    {
+        auto& workers_pool = this->pool(config);
+        chunk_count = workers_pool.plan(count, tick_grain).chunk_count;
+        if(chunk_boards.size() < chunk_count) chunk_boards.resize(chunk_count);
+
+        workers_pool.parallel_for(count, tick_grain, [&](u64 chunk, u64 begin, u64 end, u32){
+            tick_chunk(s, dt, chunk_boards[chunk], begin, end);
+        });
+
+        auto const& workers = workers_pool.last_perf();
+        perf.tick_workers   = std::min<u64>(workers.size(), engine_perf::max_tracked_workers) * cvt::to<u32>;
+        perf.tick_chunks    = workers_pool.last_chunk_count();
+        for(auto i = 0_u32; i < perf.tick_workers; ++i)
+        {
+            perf.worker_busy[i] = workers[i].busy;
+            perf.worker_idle[i] = workers[i].idle;
+        }
+    }
+    perf.object_ticks = stopwatch.since_beginning();
+
+    merge_chunk_boards(chunk_count);
+    collect_delta(s, chunk_count);
+}
+
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::tick_chunk(snapshot& s, f32 dt, chunk_board& board, u64 begin, u64 end) -> void
+{
+    GHUVA_TRACE_ZONE("engine::tick_chunk");
+    ticking = { .owner = this, .board = &board, .posted_at_tick = s.id - 1 };
+
+    // Chunks don't care about groups, so split them up as we go.
+    auto& objects = s.objects;
+    auto const first = begin;
+    for(auto group = objects.group_of(begin); begin < end; ++group)
+    {
+        auto const stop = std::min(end, objects.group_end(group));
+        if(group == 0)
         {
-            #pragma omp parallel for
-            for(auto& obj : temp.objects) if(obj.tick) obj.on_tick(obj, dt, temp, *this);
+            auto const flags = objects.flags();
+            for(auto i = begin; i < stop; ++i)
+            {
+                auto& on_tick = objects.on_tick(i);
+                if(!flags[i].tick || !on_tick) continue;
+                auto obj = objects[i];
+                obj.touched_at = s.id;
+                on_tick(obj, dt, s, *this);
+                board.ticked.push_back(obj.id);
+            }
         }
-        else
+        else if(begin < stop)
         {
-            for(auto& obj : temp.objects) if(obj.tick) obj.on_tick(obj, dt, temp, *this);
+            auto view = objects.view(begin, stop);
+            s.systems[group - 1].tick(view, dt, s, *this);
+        }
+        begin = stop;
+    }
+
+    // While it's still in cache.
+    objects.diff(committed->objects, first, end, board.changed);
+
+    ticking = {};
+}
+
+// Readers may be holding on to the last few deltas, so we reuse one nobody has anymore.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::collect_delta(snapshot& s, u64 chunk_count) -> void
+{
+    GHUVA_TRACE_ZONE("engine::collect_delta");
+    auto changed = 0_u64;
+    for(auto c = 0_u64; c < chunk_count; ++c) changed += chunk_boards[c].changed.size();
+
+    auto delta = std::shared_ptr<object_delta>{};
+    for(auto const& d : deltas)
+    {
+        if(d.use_count() != 1) continue;
+        std::atomic_thread_fence(std::memory_order_acquire); // Same deal as in recycle().
+        delta = d;
+        break;
+    }
+    if(!delta)
+    {
+        delta = std::make_shared<object_delta>();
+        if(deltas.size() < max_deltas) deltas.push_back(delta);
+    }
+
+    delta->from = committed->id;
+    delta->to   = s.id;
+    // The first chunk's changes are usually most of them, so those just trade places.
+    delta->changed.clear();
+    if(chunk_count > 0) std::swap(delta->changed, chunk_boards[0].changed);
+    delta->changed.reserve(changed);
+    for(auto c = 1_u64; c < chunk_count; ++c)
+    {
+        auto& board = chunk_boards[c];
+        delta->changed.insert(delta->changed.end(), board.changed.begin(), board.changed.end());
+        board.changed.clear();
+    }
+    delta->deleted.assign(deleted_ids.begin(), deleted_ids.end());
+    deleted_ids.clear();
+    delta->ticked.clear();
+    for(auto c = 0_u64; c < chunk_count; ++c)
+    {
+        auto& board = chunk_boards[c];
+        delta->ticked.insert(delta->ticked.end(), board.ticked.begin(), board.ticked.end());
+        board.ticked.clear();
+    }
+
+    s.engine_perf.objects_changed = changed;
+    s.delta = ghuva::move(delta);
+}
+
+// Appends the chunk boards onto the next snapshot's boards in chunk order, handing out
+// the final ids as we go. Within a chunk things were already in object order.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::merge_chunk_boards(u64 chunk_count) -> void
+{
+    GHUVA_TRACE_ZONE("engine::merge_chunk_boards");
+    constexpr auto merge = [](auto& into, auto& from, u64 first_id){
+        std::apply([&](auto&... from_regions){
+            (..., [&](auto& from_region){
+                using el_t   = ghuva::remove_cvref_t< decltype(from_region) >::value_type;
+                auto& region = into.template get<el_t>();
+                for(auto& el : from_region)
+                {
+                    el.id += first_id;
+                    region.push_back(ghuva::move(el));
+                }
+                from_region.clear();
+            }(from_regions));
+        }, from.regions);
+    };
+
+    partial_snapshot.write([&](auto& p){
+        for(auto c = 0_u64; c < chunk_count; ++c)
+        {
+            auto& board = chunk_boards[c];
+            merge(p.postboard,    board.postboard,    next_event_id.fetch_add(board.events, std::memory_order_relaxed));
+            merge(p.messageboard, board.messageboard, next_message_id.fetch_add(board.messages, std::memory_order_relaxed));
+            board.events   = 0;
+            board.messages = 0;
         }
     });
+}
 
-    // Then set this snapshot in stone.
-    last_snapshot.write([&](auto& l){
-        auto commit_stopwatch    = ghuva::chrono::stopwatch();
-        l                        = ghuva::move(temp);
-        l.engine_perf.commit     = commit_stopwatch.click().last_segment();
-        l.engine_perf.fixed_tick = fixed_tick_stopwatch.click().last_segment();
+// Whatever was posted from outside goes after what the objects posted last tick, in id
+// order among itself. Not by id against the rest: outside ids come from the same counter
+// merge_chunk_boards() draws from, so where they'd fall depends on thread timing, and board
+// order (and the object ids handed out from it) has to depend only on what got posted.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::drain_ingress(snapshot& s) -> void
+{
+    GHUVA_TRACE_ZONE("engine::drain_ingress");
+    auto const drain = [&](auto& ingress, auto& board, u64 hook_first_id){
+        std::apply([&](auto&... queues){
+            (..., [&](auto& queue){
+                using el_t   = ghuva::remove_cvref_t< decltype(queue) >::value_type;
+                auto& region = board.template get<el_t>();
+                auto const mid = region.size();
+                if(queue.drain([&](el_t&& el){ region.push_back(ghuva::move(el)); }) == 0) return;
+
+                // Producers race for their ids, so the queues are only roughly in order.
+                std::sort(region.begin() + mid, region.end(), [](auto const& a, auto const& b){ return a.id < b.id; });
+                if(ingress_hook)
+                    for(auto i = mid; i < region.size(); ++i)
+                        if(region[i].id >= hook_first_id)
+                            ingress_hook(s.id, impl::tlist_index< ingress_types, el_t >::value, &region[i]);
+            }(queues));
+        }, ingress.queues);
+    };
+
+    drain(post_ingress,    s.postboard,    hook_first_event_id);
+    drain(message_ingress, s.messageboard, hook_first_message_id);
+    s.engine_config.last_event_id   = next_event_id.load(std::memory_order_relaxed);
+    s.engine_config.last_message_id = next_message_id.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::set_ingress_hook(ingress_hook_t hook) -> void
+{
+    partial_snapshot.write([&](auto&){
+        ingress_hook          = ghuva::move(hook);
+        hook_first_event_id   = next_event_id.load(std::memory_order_relaxed);
+        hook_first_message_id = next_message_id.load(std::memory_order_relaxed);
     });
 }
 
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::add_system(std::string name, system_fn_t tick) -> u64
+{
+    u64 id;
+    partial_snapshot.write([&](auto& p){
+        p.systems.push_back({ .name = ghuva::move(name), .tick = ghuva::move(tick) });
+        id = p.systems.size();
+    });
+    return id;
+}
+
 template <typename T, typename T2>
 template <typename E>
 constexpr auto ghuva::engine<T, T2>::post(E&& event, u64 source_id) -> u64
@@ -442,22 +1249,26 @@ constexpr auto ghuva::engine<T, T2>::post(E&& event, u64 source_id) -> u64
 
     if constexpr(engine::postboard_t::template supports<Event>)
     {
-        u64 last_tick_id;
-        last_snapshot.read([&](auto const& l) {
-            last_tick_id = l.id;
-        });
-
-        u64 ret;
-        partial_snapshot.write([&](auto& p){
-            p.postboard.template get< Event >().push_back({
-                .id = p.engine_config.last_event_id,
+        if(ticking.owner == this)
+        {
+            auto& board = *ticking.board;
+            board.postboard.template get< Event >().push_back({
+                .id = board.events++,
                 .source_object_id = source_id,
-                .posted_at_tick = last_tick_id,
+                .posted_at_tick = ticking.posted_at_tick,
                 .body = ghuva::forward<E>(event)
             });
-            ret = p.engine_config.last_event_id++;
+            return deferred_id;
+        }
+
+        auto const id = next_event_id.fetch_add(1, std::memory_order_relaxed);
+        post_ingress.template get< Event >().push({
+            .id = id,
+            .source_object_id = source_id,
+            .posted_at_tick = committed_id.load(std::memory_order_acquire),
+            .body = ghuva::forward<E>(event)
         });
-        return ret;
+        return id;
     }
     else { return 0; }
 }
@@ -470,23 +1281,28 @@ constexpr auto ghuva::engine<T, T2>::message(M&& message, u64 target_id, u64 sou
 
     if constexpr(engine::messageboard_t::template supports<Message>)
     {
-        u64 last_id;
-        last_snapshot.read([&](auto const& l){
-            last_id = l.id;
-        });
-
-        u64 ret;
-        partial_snapshot.write([&](auto& p){
-            p.messageboard.template get< Message >().push_back({
-                .id = p.engine_config.last_message_id,
+        if(ticking.owner == this)
+        {
+            auto& board = *ticking.board;
+            board.messageboard.template get< Message >().push_back({
+                .id = board.messages++,
                 .target_object_id = target_id,
                 .source_object_id = source_id,
-                .posted_at_tick = last_id,
+                .posted_at_tick = ticking.posted_at_tick,
                 .body = ghuva::forward<M>(message)
             });
-            ret = p.engine_config.last_message_id++;
+            return deferred_id;
+        }
+
+        auto const id = next_message_id.fetch_add(1, std::memory_order_relaxed);
+        message_ingress.template get< Message >().push({
+            .id = id,
+            .target_object_id = target_id,
+            .source_object_id = source_id,
+            .posted_at_tick = committed_id.load(std::memory_order_acquire),
+            .body = ghuva::forward<M>(message)
         });
-        return ret;
+        return id;
     }
     else { return 0; }
 }
@@ -510,6 +1326,36 @@ constexpr auto ghuva::engine<T, T2>::snapshot::on_post(F&& f) const -> snapshot
     return *this;
 }
 
+// Straight from the hot arrays, objects never get visited one by one.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::snapshot::checksum() const -> u64
+{
+    auto hash = ghuva::fnv1a(std::span<u64 const>(&id, 1));
+    hash = ghuva::fnv1a(std::span<u64 const>(&camera_object_id, 1), hash);
+    hash = ghuva::fnv1a(std::span<f32 const>(&engine_config.total_time, 1), hash);
+    for(auto const& m : meshes) hash = ghuva::fnv1a(std::span<u64 const>(&m.id, 1), hash);
+    hash = ghuva::fnv1a(objects.ids(),        hash);
+    hash = ghuva::fnv1a(objects.transforms(), hash);
+    hash = ghuva::fnv1a(objects.mesh_ids(),   hash);
+    hash = ghuva::fnv1a(objects.flags(),      hash);
+    return hash;
+}
+
+// Messages are sorted by target before ticking so this is just a binary search.
+template <typename T, typename T2>
+template <typename M>
+constexpr auto ghuva::engine<T, T2>::snapshot::read_messages(object_ref_t& self) const -> std::span< ghuva::message<M> const >
+{
+    if constexpr(messageboard_t::template supports< ghuva::message<M> >)
+    {
+        auto const& region = messageboard.template get< ghuva::message<M> >();
+        auto const first = std::lower_bound(region.begin(), region.end(), self.id, [](auto const& m, u64 id){ return m.target_object_id < id; });
+        auto const last  = std::upper_bound(first,          region.end(), self.id, [](u64 id, auto const& m){ return id < m.target_object_id; });
+        return { first, last };
+    }
+    else { return {}; }
+}
+
 template <typename T, typename T2>
 template <typename F>
 constexpr auto ghuva::engine<T, T2>::snapshot::all_posts(F&& f) const -> snapshot const&
@@ -518,3 +1364,107 @@ constexpr auto ghuva::engine<T, T2>::snapshot::all_posts(F&& f) const -> snapsho
     return *this;
 }
 
+// Written to a temporary file first so a crash halfway doesn't take the last good save with it.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::save_snapshot(snapshot const& s, std::string const& path) -> bool
+{
+    using vertexes_t = std::span<mesh::vecf::value_type const>;
+    using indexes_t  = std::span<mesh::vecidx::value_type const>;
+
+    auto const tmp_path = path + ".tmp";
+    auto out = ghuva::binary_writer(tmp_path.c_str());
+
+    // The sizes of whatever gets written as is, to catch layout changes that forgot to bump the version.
+    out.write(snapshot_file_magic)
+       .write(snapshot_file_version)
+       .write(u32{ sizeof(transform) })
+       .write(u32{ sizeof(object_flags) })
+       .write(s.engine_config.ticks_per_second) // Field by field, engine_config has padding.
+       .write(s.engine_config.time_multiplier)
+       .write(s.engine_config.total_time)
+       .write(s.engine_config.last_mesh_id)
+       .write(s.camera_object_id);
+
+    out.write(u64{ s.systems.size() });
+    for(auto const& system : s.systems) out.write(std::string_view(system.name));
+
+    out.write(u64{ s.meshes.size() });
+    for(auto const& m : s.meshes)
+        out.write(m.id)
+           .write(vertexes_t(m.vertexes))
+           .write(vertexes_t(m.colors))
+           .write(vertexes_t(m.normals))
+           .write(indexes_t(m.indexes));
+
+    s.objects.save(out);
+
+    if(!out.close()) { std::remove(tmp_path.c_str()); return false; }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// Everything is read into locals first so a bad file leaves s as it was.
+template <typename T, typename T2>
+constexpr auto ghuva::engine<T, T2>::load_snapshot_file(snapshot& s, std::string const& path) -> bool
+{
+    auto const file = ghuva::mapped_file(path.c_str());
+    if(!file) return false;
+    auto in = ghuva::binary_reader{ .data = file.bytes() };
+
+    if(in.read<u64>() != snapshot_file_magic || in.read<u32>() != snapshot_file_version) return false;
+    if(in.read<u32>() != sizeof(transform) || in.read<u32>() != sizeof(object_flags)) return false;
+    auto const tps             = in.read<f32>();
+    auto const time_multiplier = in.read<f32>();
+    auto const total_time      = in.read<f32>();
+    auto const last_mesh_id    = in.read<u64>();
+    auto const camera          = in.read<u64>();
+
+    // Saved group g -> group now.
+    auto const system_count = in.read<u64>();
+    if(system_count > in.data.size()) return false;
+    auto group_map = std::vector<u64>(system_count + 1, 0);
+    auto same_groups = true;
+    for(auto g = 1_u64; g < group_map.size(); ++g)
+    {
+        auto const name = in.read_string();
+        auto const it   = std::find_if(s.systems.begin(), s.systems.end(), [&](auto const& system){ return system.name == name; });
+        group_map[g]    = it == s.systems.end() ? 0 : 1 + (it - s.systems.begin()) * cvt::to<u64>;
+        same_groups    &= group_map[g] == g;
+    }
+
+    auto const mesh_count = in.read<u64>();
+    if(mesh_count > in.data.size()) return false;
+    auto meshes = std::vector<mesh>(mesh_count);
+    for(auto& m : meshes)
+    {
+        auto const assign = [](auto& to, auto const& from){ to.assign(from.begin(), from.end()); };
+        m.id = in.read<u64>();
+        if(m.id == 0 || m.id >= last_mesh_id) return false; // Or the next registered mesh would reuse it.
+        assign(m.vertexes, in.template read_span<mesh::vecf::value_type>());
+        assign(m.colors,   in.template read_span<mesh::vecf::value_type>());
+        assign(m.normals,  in.template read_span<mesh::vecf::value_type>());
+        assign(m.indexes,  in.template read_span<mesh::vecidx::value_type>());
+    }
+
+    auto objects = decltype(s.objects){};
+    if(!objects.load(in) || objects.group_count() != group_map.size() || !in.ok()) return false;
+    if(same_groups) objects.set_group_count(s.systems.size() + 1);
+    else            objects.regroup(group_map, s.systems.size() + 1);
+
+    // Whatever isn't there anymore counts as deleted and everything else as just touched,
+    // so the deltas and the snapshots being recycled pick it all up.
+    for(auto const id : s.objects.ids()) if(objects.index_of(id) == objects.npos) deleted_ids.push_back(id);
+    for(auto o : objects) o.touched_at = s.id;
+
+    s.objects            = ghuva::move(objects);
+    s.meshes             = ghuva::move(meshes);
+    s.meshes_changed_at  = s.id;
+    s.meshes_replaced_at = s.id;
+    s.camera_object_id   = camera;
+
+    // The world and how fast it goes, how it gets ticked (threads, backend, ...) is up to whoever is running it now.
+    s.engine_config.ticks_per_second = tps;
+    s.engine_config.time_multiplier  = time_multiplier;
+    s.engine_config.total_time       = total_time;
+    s.engine_config.last_mesh_id     = last_mesh_id;
+    return true;
+}
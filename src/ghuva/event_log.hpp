@@ -0,0 +1,379 @@
+#pragma once
+
+#include <type_traits>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <span>
+
+#include "utils/binary_file.hpp"
+#include "utils/type_name.hpp"
+#include "utils/aliases.hpp"
+#include "utils/forward.hpp"
+#include "engine.hpp"
+
+// Recording what gets posted to an engine from outside and playing it back, so the exact same
+// run can be had again. Whatever objects post while ticking isn't recorded, replaying the
+// outside stuff is enough for them to do it all over again.
+namespace ghuva
+{
+    // How an event (or message) body gets in and out of an event log. Trivially copyable bodies
+    // are written as is, specialize this for the rest of yours. Bodies that aren't supported, or
+    // that aren't recordable() at runtime (say, they hold a callable), get logged as skipped.
+    template <typename Body>
+    struct event_codec
+    {
+        static constexpr bool supported = std::is_trivially_copyable_v<Body>;
+
+        static auto recordable(Body const&) -> bool { return true; }
+        static auto write(binary_writer& out, Body const& body) -> void { out.write(body); }
+        static auto read(binary_reader& in) -> Body { return in.read<Body>(); }
+    };
+
+    // Everything posted or messaged to engine from outside a tick, from construction until
+    // stop(), goes to a file. Play it back with replay().
+    template <typename Engine>
+    class event_recorder
+    {
+    public:
+        event_recorder(Engine& engine, std::string const& path);
+        event_recorder(event_recorder const&) = delete;
+        auto operator=(event_recorder const&) -> event_recorder& = delete;
+        ~event_recorder() { stop(); }
+
+        // Notes down how far the engine got and closes the file, replays run until there.
+        // False if anything failed along the way.
+        auto stop() -> bool;
+
+        // Only up to date after stop().
+        auto ok()       const -> bool { return out.ok(); }
+        auto recorded() const -> u64  { return recorded_count; }
+        auto skipped()  const -> u64  { return skipped_count; }
+
+    private:
+        auto record(u64 tick, u64 kind, void const* e) -> void;
+
+        Engine&       engine;
+        binary_writer out;
+        bool stopped        = false;
+        u64  recorded_count = 0;
+        u64  skipped_count  = 0;
+    };
+
+    struct replay_result
+    {
+        bool ok = false; // False if the log couldn't be used or the engine was already past it.
+        u64 ticks   = 0;
+        u64 events  = 0; // Posts and messages fed to the engine.
+        u64 skipped = 0; // The ones that couldn't be recorded, the replay isn't exact if there are any.
+    };
+
+    // Feeds the log at path to engine, each post right before the tick it landed in when recorded,
+    // ticking with step() as fast as it goes until the tick recording stopped at. on_tick(snapshot)
+    // gets every snapshot on the way, with its engine_perf and checksum() to compare builds by.
+    // engine has to be where the recorded one was when recording started, fresh and set up the same way.
+    template <typename Engine, typename F>
+    auto replay(Engine& engine, std::string const& path, F&& on_tick) -> replay_result;
+
+    namespace impl
+    {
+        // Bump whenever what event_recorder writes changes.
+        constexpr u32 event_log_version = 1;
+        constexpr u64 event_log_magic   = 0x676f'6c61'7675'6867; // "ghuvalog" on disk.
+        constexpr u32 event_log_end     = ~0_u32; // Kind of the last record, its tick is where recording stopped.
+
+        struct event_log_record
+        {
+            u64 tick = 0; // Id of the snapshot it landed in.
+            u32 kind = 0; // Index in the header's list of kinds.
+            u32 recorded = 0; // 0 = skipped, no body follows.
+            u64 id = 0;
+            u64 target_object_id = 0; // Messages only.
+            u64 source_object_id = 0;
+            u64 posted_at_tick = 0;
+        };
+
+        // event_codec, plus the engine's own bodies that aren't trivially copyable. Those are
+        // members of Engine so they can't get event_codec specializations of their own.
+        template <typename Engine>
+        struct engine_codec
+        {
+            using register_mesh    = typename Engine::register_mesh;
+            using register_object  = typename Engine::register_object;
+            using register_objects = typename Engine::register_objects;
+            using load_snapshot    = typename Engine::load_snapshot;
+            using object_t         = typename Engine::object_t;
+
+            template <typename Body>
+            static constexpr bool supported = std::is_same_v<Body, register_mesh>
+                                           || std::is_same_v<Body, register_object>
+                                           || std::is_same_v<Body, register_objects>
+                                           || std::is_same_v<Body, load_snapshot>
+                                           || event_codec<Body>::supported;
+
+            template <typename Body> static auto recordable(Body const& body) -> bool;
+            template <typename Body> static auto write(binary_writer& out, Body const& body) -> void;
+            template <typename Body> static auto read(binary_reader& in) -> Body;
+        };
+
+        // What identifies a kind across builds, a different layout is a different kind.
+        template <typename T>
+        auto kind_name() -> std::string { return std::string(ghuva::type_name<T>()) + "/" + std::to_string(sizeof(typename T::body_t)); }
+
+        // One function per kind, indexed by kind.
+        template <typename Engine, typename TList> struct ingress_kinds;
+        template <typename Engine, template <typename...> typename TList, typename... Ts>
+        struct ingress_kinds< Engine, TList<Ts...> >
+        {
+            static constexpr u64 count = sizeof...(Ts);
+
+            static auto names() -> std::array<std::string, count> { return { kind_name<Ts>()... }; }
+
+            // Fills in r and writes it, plus the body if it can be recorded. Returns whether it could.
+            static auto write(binary_writer& out, u64 kind, void const* e, event_log_record& r) -> bool
+            {
+                using fn_t = auto (*)(binary_writer&, void const*, event_log_record&) -> bool;
+                static constexpr fn_t fns[] = { &write_one<Ts>... };
+                return fns[kind](out, e, r);
+            }
+
+            // Reads the body and posts (or messages) it to engine. False if it couldn't be read.
+            static auto post(Engine& engine, u64 kind, binary_reader& in, event_log_record const& r) -> bool
+            {
+                using fn_t = auto (*)(Engine&, binary_reader&, event_log_record const&) -> bool;
+                static constexpr fn_t fns[] = { &post_one<Ts>... };
+                return fns[kind](engine, in, r);
+            }
+
+            template <typename E>
+            static auto write_one(binary_writer& out, void const* _e, event_log_record& r) -> bool
+            {
+                using body_t  = typename E::body_t;
+                using codec_t = engine_codec<Engine>;
+                auto const& e = *static_cast<E const*>(_e);
+
+                r.id               = e.id;
+                r.source_object_id = e.source_object_id;
+                r.posted_at_tick   = e.posted_at_tick;
+                if constexpr(is_message_v<E>) r.target_object_id = e.target_object_id;
+
+                if constexpr(codec_t::template supported<body_t>)
+                {
+                    r.recorded = codec_t::recordable(e.body);
+                    out.write(r);
+                    if(r.recorded) codec_t::write(out, e.body);
+                }
+                else
+                {
+                    r.recorded = 0;
+                    out.write(r);
+                }
+                return r.recorded;
+            }
+
+            template <typename E>
+            static auto post_one(Engine& engine, binary_reader& in, event_log_record const& r) -> bool
+            {
+                using body_t  = typename E::body_t;
+                using codec_t = engine_codec<Engine>;
+
+                if constexpr(codec_t::template supported<body_t>)
+                {
+                    auto body = codec_t::template read<body_t>(in);
+                    if(!in.ok()) return false;
+                    if constexpr(is_message_v<E>) engine.message(ghuva::move(body), r.target_object_id, r.source_object_id);
+                    else                          engine.post(ghuva::move(body), r.source_object_id);
+                    return true;
+                }
+                else { return false; } // Never recorded, so never gets here.
+            }
+        };
+    }
+}
+
+// Impls.
+
+template <typename Engine>
+ghuva::event_recorder<Engine>::event_recorder(Engine& engine, std::string const& path)
+    : engine{ engine }
+    , out{ path.c_str() }
+{
+    using kinds = impl::ingress_kinds< Engine, typename Engine::ingress_types >;
+
+    out.write(impl::event_log_magic)
+       .write(impl::event_log_version)
+       .write(u64{ kinds::count });
+    for(auto const& name : kinds::names()) out.write(std::string_view(name));
+
+    if(!out.ok()) { stopped = true; return; }
+    engine.set_ingress_hook([this](u64 tick, u64 kind, void const* e){ this->record(tick, kind, e); });
+}
+
+template <typename Engine>
+auto ghuva::event_recorder<Engine>::stop() -> bool
+{
+    if(stopped) return out.ok();
+    stopped = true;
+
+    // Nothing gets recorded after this returns, so the tick we read next is as good as any.
+    engine.set_ingress_hook(nullptr);
+    out.write(impl::event_log_record{ .tick = engine.take_snapshot()->id, .kind = impl::event_log_end });
+    return out.close();
+}
+
+template <typename Engine>
+auto ghuva::event_recorder<Engine>::record(u64 tick, u64 kind, void const* e) -> void
+{
+    using kinds = impl::ingress_kinds< Engine, typename Engine::ingress_types >;
+
+    auto r = impl::event_log_record{ .tick = tick, .kind = static_cast<u32>(kind) };
+    if(kinds::write(out, kind, e, r)) ++recorded_count;
+    else                              ++skipped_count;
+}
+
+// Outside posts land on the boards after the ones the objects made, in id order per kind (see
+// engine::drain_ingress()), which is the order they were logged in. So feeding them in that
+// order right before their tick puts them back where they were when recorded.
+template <typename Engine, typename F>
+auto ghuva::replay(Engine& engine, std::string const& path, F&& on_tick) -> replay_result
+{
+    using kinds = impl::ingress_kinds< Engine, typename Engine::ingress_types >;
+
+    auto result = replay_result{};
+    auto const file = ghuva::mapped_file(path.c_str());
+    if(!file) return result;
+    auto in = ghuva::binary_reader{ .data = file.bytes() };
+
+    if(in.read<u64>() != impl::event_log_magic || in.read<u32>() != impl::event_log_version) return result;
+
+    // Kinds are matched by name, so only logs with events this build doesn't have can't be replayed.
+    auto const names      = kinds::names();
+    auto const kind_count = in.read<u64>();
+    if(kind_count > in.data.size()) return result;
+    auto kind_map = std::vector<u64>(kind_count); // Logged kind -> ours, kinds::count = unknown.
+    for(auto& k : kind_map)
+    {
+        auto const name = in.read_string();
+        k = std::find(names.begin(), names.end(), name) - names.begin();
+    }
+    if(!in.ok()) return result;
+
+    auto tick = engine.take_snapshot()->id;
+    auto const step_until = [&](u64 until){
+        for(; tick < until; ++tick, ++result.ticks)
+        {
+            engine.step();
+            on_tick(*engine.take_snapshot());
+        }
+    };
+
+    while(true)
+    {
+        auto const r = in.read<impl::event_log_record>();
+        if(!in.ok()) return result;
+
+        if(r.kind == impl::event_log_end)
+        {
+            step_until(r.tick);
+            result.ok = true;
+            return result;
+        }
+        if(r.kind >= kind_map.size() || kind_map[r.kind] == kinds::count) return result;
+
+        if(!r.recorded) { ++result.skipped; continue; }
+        if(r.tick <= tick) return result; // The engine is already past it.
+
+        step_until(r.tick - 1);
+        if(!kinds::post(engine, kind_map[r.kind], in, r)) return result;
+        ++result.events;
+    }
+}
+
+template <typename Engine>
+template <typename Body>
+auto ghuva::impl::engine_codec<Engine>::recordable(Body const& body) -> bool
+{
+    // No telling what a callable does, so objects with an on_tick (or an init) can't be recorded.
+         if constexpr(std::is_same_v<Body, register_object>)  { return !body.object.on_tick; }
+    else if constexpr(std::is_same_v<Body, register_objects>) { return !body.prototype.on_tick && !body.init; }
+    else if constexpr(std::is_same_v<Body, register_mesh> || std::is_same_v<Body, load_snapshot>) { return true; }
+    else { return event_codec<Body>::recordable(body); }
+}
+
+template <typename Engine>
+template <typename Body>
+auto ghuva::impl::engine_codec<Engine>::write(binary_writer& out, Body const& body) -> void
+{
+    using vertexes_t = std::span<mesh::vecf::value_type const>;
+    using indexes_t  = std::span<mesh::vecidx::value_type const>;
+
+    constexpr auto write_object = [](binary_writer& out, object_t const& o){
+        out.write(std::string_view(o.name))
+           .write(o.t)
+           .write(o.mesh_id)
+           .write(o.system)
+           .write(o.draw)
+           .write(o.tick);
+    };
+
+    if constexpr(std::is_same_v<Body, register_mesh>)
+    {
+        out.write(vertexes_t(body.mesh.vertexes))
+           .write(vertexes_t(body.mesh.colors))
+           .write(vertexes_t(body.mesh.normals))
+           .write(indexes_t(body.mesh.indexes));
+    }
+    else if constexpr(std::is_same_v<Body, register_object>) { write_object(out, body.object); }
+    else if constexpr(std::is_same_v<Body, register_objects>)
+    {
+        write_object(out, body.prototype);
+        out.write(body.count)
+           .write(std::span<transform const>(body.transforms));
+    }
+    else if constexpr(std::is_same_v<Body, load_snapshot>) { out.write(std::string_view(body.path)); }
+    else { event_codec<Body>::write(out, body); }
+}
+
+template <typename Engine>
+template <typename Body>
+auto ghuva::impl::engine_codec<Engine>::read(binary_reader& in) -> Body
+{
+    using vertex_t = mesh::vecf::value_type;
+    using index_t  = mesh::vecidx::value_type;
+
+    constexpr auto assign = [](auto& to, auto const& from){ to.assign(from.begin(), from.end()); };
+    constexpr auto read_object = [](binary_reader& in) -> object_t {
+        auto const name = in.read_string();
+        return {{
+            .name    = std::string(name),
+            .t       = in.read<transform>(),
+            .on_tick = {},
+            .mesh_id = in.read<u64>(),
+            .system  = in.read<u64>(),
+            .draw    = in.read<bool>(),
+            .tick    = in.read<bool>(),
+        }};
+    };
+
+    if constexpr(std::is_same_v<Body, register_mesh>)
+    {
+        auto body = register_mesh{};
+        assign(body.mesh.vertexes, in.read_span<vertex_t>());
+        assign(body.mesh.colors,   in.read_span<vertex_t>());
+        assign(body.mesh.normals,  in.read_span<vertex_t>());
+        assign(body.mesh.indexes,  in.read_span<index_t>());
+        return body;
+    }
+    else if constexpr(std::is_same_v<Body, register_object>) { return { .object = read_object(in) }; }
+    else if constexpr(std::is_same_v<Body, register_objects>)
+    {
+        auto body = register_objects{ .prototype = read_object(in) };
+        body.count = in.read<u64>();
+        assign(body.transforms, in.read_span<transform>());
+        return body;
+    }
+    else if constexpr(std::is_same_v<Body, load_snapshot>) { return { .path = std::string(in.read_string()), .success = false }; }
+    else { return event_codec<Body>::read(in); }
+}
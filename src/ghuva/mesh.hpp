@@ -2,14 +2,18 @@
 
 #include <vector>
 
-#include "context.hpp"
+#include "utils/aliases.hpp"
 
 namespace ghuva
 {
     struct mesh
     {
-        using vecf = std::vector<context::vertex_t>;
-        using vecidx = std::vector<context::index_t>;
+        // What ends up in the GPU buffers, context uses these too.
+        using vertex_t = f32;
+        using index_t  = u16;
+
+        using vecf = std::vector<vertex_t>;
+        using vecidx = std::vector<index_t>;
 
         u64 id; // Assigned by the engine.
 
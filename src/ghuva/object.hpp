@@ -1,32 +1,55 @@
 #pragma once
 
-#include <functional>
+#include <type_traits>
 #include <string>
 
+#include "utils/inplace_function.hpp"
 #include "utils/point.hpp"
 #include "utils/m4.hpp"
 #include "transform.hpp"
-#include "context.hpp"
 
 namespace ghuva
 {
+    // How objects are seen once they are in the engine. Their hot state (transform, flags,
+    // mesh) lives in separate arrays from the rest, so this just bundles references to it all.
+    template< typename Engine, bool Const = false >
+    struct object_ref
+    {
+        using engine_t = Engine;
+        template <typename T> using ref_t = std::conditional_t<Const, T const&, T&>;
+
+        u64 const&         id;
+        ref_t<u64>         touched_at;
+        ref_t<std::string> name;
+        ref_t<u64>         mesh_id;
+        ref_t<bool>        draw;
+        ref_t<bool>        tick;
+        ref_t<transform>   t;
+    };
+
+    // What you register with the engine.
     template< typename Engine >
     struct object
     {
         using engine_t   = Engine;
         using snapshot_t = typename engine_t::snapshot;
+        using ref_t      = ghuva::object_ref<Engine>;
+        using cref_t     = ghuva::object_ref<Engine, true>;
 
-        using on_tick_t = std::function<void(
-            object& self,
+        // Whatever on_tick captures has to fit in on_tick_t::capacity bytes.
+        using on_tick_t = ghuva::inplace_function<void(
+            ref_t& self,
             float dt,
             snapshot_t const& snapshot,
             engine_t& engine
         )>;
 
         u64 id = 0; // Assigned by the engine. 0 = invalid.
+        u64 touched_at = 0; // Id of the last snapshot this object was ticked or changed in, maintained by the engine.
 
         std::string name = "";
         u64 mesh_id = 0; // Registered by the engine. 0 = invalid.
+        u64 system = 0; // Id of the system that ticks this object instead of on_tick, 0 = none. See engine::add_system.
         bool draw = true;
         bool tick = true;
         transform t = {};
@@ -35,8 +58,9 @@ namespace ghuva
         {
             std::string name = "";
             transform t = {};
-            on_tick_t on_tick = [](object&, float, snapshot_t const&, engine_t&){};
+            on_tick_t on_tick = {}; // Empty = nothing to do on tick.
             u64 mesh_id = 0;
+            u64 system = 0;
             bool draw = true;
             bool tick = true;
         };
@@ -45,7 +69,7 @@ namespace ghuva
 
         auto look_at(fpoint const& target) -> object&;
 
-        on_tick_t on_tick = [](object&, float, snapshot_t const&, engine_t&){};
+        on_tick_t on_tick;
     };
 }
 
@@ -55,6 +79,7 @@ template <typename E>
 ghuva::object<E>::object(constructorargs&& args)
     : name{ ghuva::move(args.name) }
     , mesh_id{ args.mesh_id }
+    , system{ args.system }
     , draw{ args.draw }
     , tick{ args.tick }
     , t{ ghuva::move(args.t) }
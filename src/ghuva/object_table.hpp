@@ -0,0 +1,522 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+
+#include "utils/binary_file.hpp"
+#include "utils/slot_map.hpp"
+#include "utils/aliases.hpp"
+#include "utils/forward.hpp"
+#include "transform.hpp"
+#include "object.hpp"
+
+namespace ghuva
+{
+    struct object_flags
+    {
+        bool draw;
+        bool tick;
+    };
+
+    // A contiguous run of objects in an object_table, what systems get to work on.
+    struct objects_view
+    {
+        u64 first_index;
+        std::span<u64 const>    ids;
+        std::span<transform>    transforms;
+        std::span<u64>          mesh_ids;
+        std::span<object_flags> flags;
+
+        constexpr auto size() const -> u64 { return ids.size(); }
+    };
+
+    // An object that is new or differs from how it was, with its values as of the newer snapshot.
+    struct object_change
+    {
+        enum bits : u8
+        {
+            created           = 1 << 0,
+            transform_changed = 1 << 1,
+            draw_changed      = 1 << 2,
+            mesh_changed      = 1 << 3,
+            tick_changed      = 1 << 4, // Only flags.tick, which isn't in here.
+        };
+
+        u64  id;
+        u8   what; // bits.
+        bool draw;
+        u64  mesh_id;
+        ghuva::transform t;
+    };
+
+    // What it takes to go from snapshot `from` to snapshot `to`, only the hot state is tracked.
+    struct object_delta
+    {
+        u64 from = 0;
+        u64 to   = 0;
+        std::vector<object_change> changed = {}; // Object order of `to` for single tick deltas, id order otherwise.
+        std::vector<u64>           deleted = {};
+        std::vector<u64>           ticked  = {}; // Ids of the ones whose on_tick ran (so their cold state changed), single tick deltas only.
+
+        constexpr auto empty() const -> bool { return changed.empty() && deleted.empty(); }
+    };
+
+    // Where the engine keeps its objects. The hot per-object state gets an array of its own
+    // (ids, transforms, mesh ids, flags) so passes over it don't drag names and callables
+    // through the cache. Everything is indexed the same, by the dense index of the object.
+    //
+    // Objects are kept grouped by object::system, group 0 (no system) first, then the objects
+    // of system 1 and so on. That way a system gets all of its objects as contiguous arrays.
+    //
+    // Object ids are the keys of the slot_map underneath, see slot_map for what that means.
+    template< typename Engine >
+    struct object_table
+    {
+        using object_t  = ghuva::object<Engine>;
+        using ref_t     = object_t::ref_t;
+        using cref_t    = object_t::cref_t;
+        using on_tick_t = object_t::on_tick_t;
+        static constexpr u64 npos = ghuva::slot_map<int>::npos;
+
+        using flags_t   = ghuva::object_flags;
+        using view_t    = ghuva::objects_view;
+
+        // Returns the id of the new object.
+        constexpr auto insert(object_t const& o) -> u64;
+        // count copies of prototype with ids [first, first + count). Returns first.
+        // They end up next to each other but not necessarily in id order, use index_of().
+        constexpr auto append(u64 count, object_t const& prototype) -> u64;
+        // False if there was no such object.
+        constexpr auto erase(u64 id) -> bool;
+
+        constexpr auto index_of(u64 id) const -> u64 { return cold.index_of(id); } // npos if not found.
+        constexpr auto find(u64 id)       -> std::optional<ref_t>;
+        constexpr auto find(u64 id) const -> std::optional<cref_t>;
+
+        constexpr auto operator[](u64 index)       -> ref_t;
+        constexpr auto operator[](u64 index) const -> cref_t;
+        constexpr auto on_tick(u64 index) -> on_tick_t& { return cold[index].on_tick; }
+        constexpr auto view(u64 begin, u64 end) -> view_t;
+
+        constexpr auto size()  const -> u64  { return cold.size(); }
+        constexpr auto empty() const -> bool { return cold.empty(); }
+
+        // Groups only ever get added. Objects asking for a group
+        // that doesn't exist (yet) are put in group 0.
+        constexpr auto group_count() const -> u64 { return group_ends.size(); }
+        constexpr auto set_group_count(u64 count) -> void;
+        constexpr auto group_begin(u64 group) const -> u64 { return group == 0 ? 0 : group_ends[group - 1]; }
+        constexpr auto group_end(u64 group)   const -> u64 { return group_ends[group]; }
+        constexpr auto group_of(u64 index)    const -> u64;
+
+        // The hot arrays themselves. Don't go resizing them.
+        constexpr auto ids()        const -> std::span<u64 const>       { return hot_ids; }
+        constexpr auto transforms()       -> std::span<transform>       { return hot_transforms; }
+        constexpr auto transforms() const -> std::span<transform const> { return hot_transforms; }
+        constexpr auto mesh_ids()         -> std::span<u64>             { return hot_mesh_ids; }
+        constexpr auto mesh_ids()   const -> std::span<u64 const>       { return hot_mesh_ids; }
+        constexpr auto flags()            -> std::span<flags_t>         { return hot_flags; }
+        constexpr auto flags()      const -> std::span<flags_t const>   { return hot_flags; }
+
+        // Hands out refs, so iterate with `auto obj` or `auto const& obj`.
+        template <bool Const>
+        struct iterator_t
+        {
+            std::conditional_t<Const, object_table const, object_table>* table;
+            u64 index;
+
+            constexpr auto operator*() const { return (*table)[index]; }
+            constexpr auto operator++() -> iterator_t& { ++index; return *this; }
+            constexpr auto operator==(iterator_t const&) const -> bool = default;
+        };
+        constexpr auto begin()       -> iterator_t<false> { return { this, 0 }; }
+        constexpr auto end()         -> iterator_t<false> { return { this, size() }; }
+        constexpr auto begin() const -> iterator_t<true>  { return { this, 0 }; }
+        constexpr auto end()   const -> iterator_t<true>  { return { this, size() }; }
+
+        // Makes this equal to from. Given the deltas that go from this to from, in order, and as
+        // long as nothing was created, deleted or moved around in between, only the objects in
+        // them get copied: the hot state of the changed ones and the cold state of the ticked
+        // ones (anything else only changes it along with the layout). Past a quarter of the
+        // objects the hot arrays get copied wholesale and the cold state wherever changed(touched_at)
+        // says so, through slot_map::catch_up (bookkeeping included) if the layout changed too.
+        // Returns how many objects had their cold state copied.
+        template <typename F>
+        constexpr auto catch_up(
+            object_table const& from,
+            F&& changed,
+            std::optional< std::span<object_delta const* const> > deltas = std::nullopt
+        ) -> u64;
+
+        // Appends the objects in [begin, end) that are new or differ from how they are in from.
+        constexpr auto diff(object_table const& from, u64 begin, u64 end, std::vector<object_change>& changed) const -> void;
+
+        // Writes out everything but on_tick, which can't be, ids stay the same across save() and load().
+        constexpr auto save(ghuva::binary_writer& out) const -> void;
+        // Replaces everything here with what save() wrote, objects come back without an on_tick and in
+        // the groups they were saved in. False if the data doesn't add up, this is garbage then.
+        constexpr auto load(ghuva::binary_reader& in) -> bool;
+        // Moves the objects in group g to group group_map[g], keeping their order within each group.
+        constexpr auto regroup(std::span<u64 const> group_map, u64 group_count) -> void;
+
+    private:
+        // Only touched when ticking an object with on_tick or doing something by id.
+        struct cold_t
+        {
+            u64 touched_at;
+            std::string name;
+            on_tick_t on_tick;
+        };
+
+        constexpr auto swap(u64 a, u64 b) -> void;
+        // Moves the count objects at the very end into group, which grows by count.
+        constexpr auto settle(u64 count, u64 group) -> void;
+
+        ghuva::slot_map<cold_t> cold;
+        std::vector<u64>        hot_ids;
+        std::vector<transform>  hot_transforms;
+        std::vector<u64>        hot_mesh_ids;
+        std::vector<flags_t>    hot_flags;
+        std::vector<u64>        group_ends = { 0 }; // One past the last object of each group.
+
+        // Changes whenever objects come, go or move to another index. Two tables with the same
+        // one have their objects at the same indexes, since they're unique across all tables.
+        u64 layout = 0;
+        static auto new_layout() -> u64
+        {
+            static constinit std::atomic<u64> next = 1;
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+}
+
+// Impls.
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::insert(object_t const& o) -> u64
+{
+    auto const id = cold.insert({ .touched_at = o.touched_at, .name = o.name, .on_tick = o.on_tick });
+    hot_ids.push_back(id);
+    hot_transforms.push_back(o.t);
+    hot_mesh_ids.push_back(o.mesh_id);
+    hot_flags.push_back({ .draw = o.draw, .tick = o.tick });
+
+    layout = new_layout();
+    settle(1, o.system);
+    return id;
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::append(u64 count, object_t const& prototype) -> u64
+{
+    auto const base  = size();
+    auto const first = cold.append(count, { .touched_at = prototype.touched_at, .name = prototype.name, .on_tick = prototype.on_tick });
+
+    hot_ids.resize(base + count);
+    for(auto i = 0_u64; i < count; ++i) hot_ids[base + i] = first + i;
+    hot_transforms.resize(base + count, prototype.t);
+    hot_mesh_ids.resize(base + count, prototype.mesh_id);
+    hot_flags.resize(base + count, { .draw = prototype.draw, .tick = prototype.tick });
+
+    layout = new_layout();
+    settle(count, prototype.system);
+    return first;
+}
+
+// Shifts the hole left by the groups after this one to the very end, one object per group.
+template <typename E>
+constexpr auto ghuva::object_table<E>::erase(u64 id) -> bool
+{
+    auto index = cold.index_of(id);
+    if(index == npos) return false;
+
+    layout = new_layout();
+    for(auto g = group_of(index); g < group_count(); ++g)
+    {
+        auto const last = --group_ends[g];
+        swap(index, last);
+        index = last;
+    }
+
+    cold.erase(id); // Last one by now, so nothing else moves.
+    hot_ids.pop_back();
+    hot_transforms.pop_back();
+    hot_mesh_ids.pop_back();
+    hot_flags.pop_back();
+    return true;
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::find(u64 id) -> std::optional<ref_t>
+{
+    auto const index = index_of(id);
+    if(index == npos) return std::nullopt;
+    return (*this)[index];
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::find(u64 id) const -> std::optional<cref_t>
+{
+    auto const index = index_of(id);
+    if(index == npos) return std::nullopt;
+    return (*this)[index];
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::operator[](u64 index) -> ref_t
+{
+    auto& c = cold[index];
+    auto& f = hot_flags[index];
+    return { hot_ids[index], c.touched_at, c.name, hot_mesh_ids[index], f.draw, f.tick, hot_transforms[index] };
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::operator[](u64 index) const -> cref_t
+{
+    auto const& c = cold[index];
+    auto const& f = hot_flags[index];
+    return { hot_ids[index], c.touched_at, c.name, hot_mesh_ids[index], f.draw, f.tick, hot_transforms[index] };
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::view(u64 begin, u64 end) -> view_t
+{
+    auto const count = end - begin;
+    return {
+        .first_index = begin,
+        .ids         = std::span<u64 const>(hot_ids).subspan(begin, count),
+        .transforms  = std::span(hot_transforms).subspan(begin, count),
+        .mesh_ids    = std::span(hot_mesh_ids).subspan(begin, count),
+        .flags       = std::span(hot_flags).subspan(begin, count),
+    };
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::set_group_count(u64 count) -> void
+{
+    if(count > group_ends.size()) group_ends.resize(count, size());
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::group_of(u64 index) const -> u64
+{
+    return std::upper_bound(group_ends.begin(), group_ends.end(), index) - group_ends.begin();
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::swap(u64 a, u64 b) -> void
+{
+    if(a == b) return;
+    cold.swap(a, b);
+    std::swap(hot_ids[a],        hot_ids[b]);
+    std::swap(hot_transforms[a], hot_transforms[b]);
+    std::swap(hot_mesh_ids[a],   hot_mesh_ids[b]);
+    std::swap(hot_flags[a],      hot_flags[b]);
+}
+
+// The new objects hop over each group after theirs by swapping places with as many of the
+// group's first objects as possible, so it's O(count) per group no matter how big they are.
+template <typename E>
+constexpr auto ghuva::object_table<E>::settle(u64 count, u64 group) -> void
+{
+    if(group >= group_count()) group = 0;
+
+    auto block = size() - count;
+    group_ends.back() += count;
+    for(auto g = group_count() - 1; g > group; --g)
+    {
+        auto const begin = group_begin(g);
+        auto const moved = std::min(count, block - begin);
+        for(auto i = 0_u64; i < moved; ++i) swap(begin + i, block + count - moved + i);
+
+        group_ends[g - 1] += count;
+        block = begin;
+    }
+}
+
+template <typename E>
+template <typename F>
+constexpr auto ghuva::object_table<E>::catch_up(
+    object_table const& from,
+    F&& changed,
+    std::optional< std::span<object_delta const* const> > deltas
+) -> u64
+{
+    // Past a quarter of the objects, one lookup per change costs more than copying everything.
+    auto const same_layout = deltas && layout == from.layout;
+    auto changes = 0_u64;
+    auto ticked  = 0_u64;
+    if(deltas) for(auto const* delta : *deltas) { changes += delta->changed.size(); ticked += delta->ticked.size(); }
+
+    if(same_layout && changes * 4 < size())
+    {
+        // Same objects at the same indexes, only what the deltas touched can differ.
+        for(auto const* delta : *deltas)
+            for(auto const& c : delta->changed)
+            {
+                auto const i = from.index_of(c.id);
+                hot_transforms[i] = from.hot_transforms[i];
+                hot_mesh_ids[i]   = from.hot_mesh_ids[i];
+                hot_flags[i]      = from.hot_flags[i];
+            }
+    }
+    else
+    {
+        hot_ids        = from.hot_ids;
+        hot_transforms = from.hot_transforms;
+        hot_mesh_ids   = from.hot_mesh_ids;
+        hot_flags      = from.hot_flags;
+        layout         = from.layout;
+    }
+    group_ends = from.group_ends; // Can grow on its own, groups only ever get added.
+
+    if(!same_layout) return cold.catch_up(from.cold, [&](cold_t const& c){ return changed(c.touched_at); });
+
+    // Same keys at the same indexes, so the slot_map bookkeeping already matches.
+    auto copied = 0_u64;
+    if(ticked * 4 >= size())
+    {
+        for(auto i = 0_u64; i < size(); ++i)
+        {
+            if(!changed(from.cold[i].touched_at)) continue;
+            cold[i] = from.cold[i];
+            ++copied;
+        }
+        return copied;
+    }
+
+    // An object ticked more than once in between only gets copied for the last of them.
+    for(auto const* delta : *deltas)
+        copied += cold.catch_up(from.cold, std::span<u64 const>(delta->ticked), [&](cold_t const& c){
+            return c.touched_at == delta->to && changed(c.touched_at);
+        });
+    return copied;
+}
+
+// Objects mostly keep their index from one snapshot to the next, so we only go looking for them when they didn't.
+// Compares bytes so that anything written counts, even if it compares equal as floats.
+template <typename E>
+constexpr auto ghuva::object_table<E>::diff(object_table const& from, u64 begin, u64 end, std::vector<object_change>& changed) const -> void
+{
+    for(auto i = begin; i < end; ++i)
+    {
+        auto const id = hot_ids[i];
+        auto j = i;
+        if(j >= from.size() || from.hot_ids[j] != id) j = from.index_of(id);
+
+        auto what = u8{0};
+        if(j == npos) what = object_change::created | object_change::transform_changed | object_change::draw_changed | object_change::mesh_changed;
+        else
+        {
+            if(std::memcmp(&hot_transforms[i], &from.hot_transforms[j], sizeof(transform)) != 0) what |= object_change::transform_changed;
+            if(hot_flags[i].draw != from.hot_flags[j].draw) what |= object_change::draw_changed;
+            if(hot_mesh_ids[i]   != from.hot_mesh_ids[j])   what |= object_change::mesh_changed;
+            if(hot_flags[i].tick != from.hot_flags[j].tick) what |= object_change::tick_changed;
+            if(what == 0) continue;
+        }
+
+        changed.push_back({ .id = id, .what = what, .draw = hot_flags[i].draw, .mesh_id = hot_mesh_ids[i], .t = hot_transforms[i] });
+    }
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::save(ghuva::binary_writer& out) const -> void
+{
+    // The cold state gets flattened so it can be written in one go too.
+    auto touched_at = std::vector<u64>(size());
+    auto name_ends  = std::vector<u64>(size());
+    auto names      = std::string{};
+    for(auto i = 0_u64; i < size(); ++i)
+    {
+        touched_at[i] = cold[i].touched_at;
+        names        += cold[i].name;
+        name_ends[i]  = names.size();
+    }
+
+    out.write(std::span<u64 const>(hot_ids))
+       .write(std::span<transform const>(hot_transforms))
+       .write(std::span<u64 const>(hot_mesh_ids))
+       .write(std::span<flags_t const>(hot_flags))
+       .write(std::span<u64 const>(group_ends))
+       .write(std::span<u64 const>(touched_at))
+       .write(std::span<u64 const>(name_ends))
+       .write(std::string_view(names))
+       .write(cold.raw_value_slots())
+       .write(cold.raw_slots())
+       .write(cold.raw_free_head());
+}
+
+template <typename E>
+constexpr auto ghuva::object_table<E>::load(ghuva::binary_reader& in) -> bool
+{
+    using slot_t = ghuva::slot_map<cold_t>::slot;
+
+    auto const ids         = in.read_span<u64>();
+    auto const transforms  = in.read_span<transform>();
+    auto const mesh_ids    = in.read_span<u64>();
+    auto const flags       = in.read_span<flags_t>();
+    auto const ends        = in.read_span<u64>();
+    auto const touched_at  = in.read_span<u64>();
+    auto const name_ends   = in.read_span<u64>();
+    auto const names       = in.read_string();
+    auto const value_slots = in.read_span<u32>();
+    auto const slots       = in.read_span<slot_t>();
+    auto const free_head   = in.read<u32>();
+
+    auto const n = ids.size();
+    layout = new_layout();
+    if(!in.ok()) return false;
+    if(transforms.size() != n || mesh_ids.size() != n || flags.size() != n || touched_at.size() != n || name_ends.size() != n) return false;
+    if(ends.empty() || ends.back() != n || !std::is_sorted(ends.begin(), ends.end())) return false;
+    if(!std::is_sorted(name_ends.begin(), name_ends.end()) || (n > 0 && name_ends.back() > names.size())) return false;
+    if(!cold.restore(value_slots, slots, free_head)) return false;
+    for(auto i = 0_u64; i < n; ++i) if(cold.key_at(i) != ids[i]) return false;
+
+    // The bulk of it is just copying arrays over.
+    hot_ids.assign(ids.begin(), ids.end());
+    hot_transforms.assign(transforms.begin(), transforms.end());
+    hot_mesh_ids.assign(mesh_ids.begin(), mesh_ids.end());
+    hot_flags.assign(flags.begin(), flags.end());
+    group_ends.assign(ends.begin(), ends.end());
+    for(auto i = 0_u64; i < n; ++i)
+    {
+        auto const name_begin = i == 0 ? 0 : name_ends[i - 1];
+        cold[i].touched_at = touched_at[i];
+        cold[i].name.assign(names.substr(name_begin, name_ends[i] - name_begin));
+    }
+    return true;
+}
+
+// A counting sort by new group, done in place by following the cycles of the permutation.
+template <typename E>
+constexpr auto ghuva::object_table<E>::regroup(std::span<u64 const> group_map, u64 group_count) -> void
+{
+    layout = new_layout();
+    auto new_ends = std::vector<u64>(group_count, 0);
+    for(auto g = 0_u64; g < this->group_count(); ++g) new_ends[group_map[g]] += group_end(g) - group_begin(g);
+    for(auto g = 1_u64; g < group_count; ++g) new_ends[g] += new_ends[g - 1];
+
+    auto next = std::vector<u64>(group_count, 0);
+    for(auto g = 1_u64; g < group_count; ++g) next[g] = new_ends[g - 1];
+
+    auto target = std::vector<u64>(size());
+    for(auto g = 0_u64; g < this->group_count(); ++g)
+        for(auto i = group_begin(g); i < group_end(g); ++i) target[i] = next[group_map[g]]++;
+
+    for(auto i = 0_u64; i < size(); ++i)
+        while(target[i] != i)
+        {
+            auto const t = target[i];
+            swap(i, t);
+            std::swap(target[i], target[t]);
+        }
+
+    group_ends = ghuva::move(new_ends);
+}
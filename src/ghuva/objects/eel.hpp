@@ -29,6 +29,16 @@ namespace ghuva::objects::eel_impl
         );
     }
 
+    constexpr auto on_register_objects(auto const& snapshot, auto& self, auto const& e)
+    {
+        auto const count = e.body.count != 0 ? e.body.count : e.body.transforms.size();
+        fmt::print(
+            "[ghuva::engine/t{}][o{}/{}][e{}/o{}] Engine registered {} objects {{ .ids=[{}, {}), .name=\"{}\" }}\n",
+            snapshot.id, self.id, self.name, e.id, e.source_object_id,
+            count, e.body.first_id, e.body.first_id + count, e.body.prototype.name
+        );
+    }
+
     constexpr auto on_register_mesh(auto const& snapshot, auto& self, auto const& e)
     {
         fmt::print(
@@ -87,11 +97,12 @@ namespace ghuva::objects::eel_impl
                     for(auto const& e : el_vec) func(snapshot, self, e);  \
                 }
 
-                 GHUVA_EEL_FOREACH( typename engine_t::e_register_object, on_register_object )
-            else GHUVA_EEL_FOREACH( typename engine_t::e_register_mesh,   on_register_mesh )
-            else GHUVA_EEL_FOREACH( typename engine_t::e_delete_object,   on_delete_object )
-            else GHUVA_EEL_FOREACH( typename engine_t::e_set_tps,         on_set_tps )
-            else GHUVA_EEL_FOREACH( typename engine_t::e_set_camera,      on_set_camera )
+                 GHUVA_EEL_FOREACH( typename engine_t::e_register_object,  on_register_object )
+            else GHUVA_EEL_FOREACH( typename engine_t::e_register_objects, on_register_objects )
+            else GHUVA_EEL_FOREACH( typename engine_t::e_register_mesh,    on_register_mesh )
+            else GHUVA_EEL_FOREACH( typename engine_t::e_delete_object,    on_delete_object )
+            else GHUVA_EEL_FOREACH( typename engine_t::e_set_tps,          on_set_tps )
+            else GHUVA_EEL_FOREACH( typename engine_t::e_set_camera,       on_set_camera )
             else { for(auto const& e : el_vec) on_unkown_event(snapshot, self, e); }
         });
     }
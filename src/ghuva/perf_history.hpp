@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <span>
+#include <cstdio>
+
+#include <fmt/core.h>
+
+#include "utils/aliases.hpp"
+
+namespace ghuva
+{
+    // One tick's worth of engine_perf plus some context, what engine::perf_history() keeps.
+    // Times in seconds.
+    struct perf_record
+    {
+        u64 tick;
+        u64 objects;
+        u64 objects_copied;
+        u64 objects_changed;
+        u64 events;   // On the postboard this tick.
+        u64 messages; // On the messageboard this tick.
+
+        f32 fixed_tick;
+        f32 commit; // This tick's own, unlike engine_perf::commit.
+        f32 copy_objects;
+        f32 engine_events;
+        f32 sort_messages;
+        f32 load_snapshot;
+        f32 delete_objects;
+        f32 register_objects;
+        f32 register_meshes;
+        f32 object_ticks;
+    };
+
+    // Every timing in a perf_record, by name.
+    struct perf_phase
+    {
+        char const* name;
+        f32 perf_record::* seconds;
+    };
+    constexpr auto perf_phases = std::array<perf_phase, 10>{{
+        { "fixed_tick",       &perf_record::fixed_tick },
+        { "commit",           &perf_record::commit },
+        { "copy_objects",     &perf_record::copy_objects },
+        { "engine_events",    &perf_record::engine_events },
+        { "sort_messages",    &perf_record::sort_messages },
+        { "load_snapshot",    &perf_record::load_snapshot },
+        { "delete_objects",   &perf_record::delete_objects },
+        { "register_objects", &perf_record::register_objects },
+        { "register_meshes",  &perf_record::register_meshes },
+        { "object_ticks",     &perf_record::object_ticks },
+    }};
+
+    struct perf_percentiles
+    {
+        u64 samples = 0;
+        f32 p50 = 0.0f;
+        f32 p95 = 0.0f;
+        f32 p99 = 0.0f;
+        f32 max = 0.0f;
+    };
+
+    // Of one phase over whatever window of records, nearest-rank.
+    auto percentiles(std::span<perf_record const> records, f32 perf_record::* phase) -> perf_percentiles;
+
+    // One row/object per record with every field, oldest first as given. False if writing failed.
+    auto write_perf_csv(std::FILE* out, std::span<perf_record const> records) -> bool;
+    auto write_perf_json(std::FILE* out, std::span<perf_record const> records) -> bool;
+}
+
+// Impls.
+
+inline auto ghuva::percentiles(std::span<perf_record const> records, f32 perf_record::* phase) -> perf_percentiles
+{
+    if(records.empty()) return {};
+
+    auto samples = std::vector<f32>(records.size());
+    std::transform(records.begin(), records.end(), samples.begin(), [&](auto const& r){ return r.*phase; });
+    std::sort(samples.begin(), samples.end());
+
+    auto const at = [&](f32 p){ return samples[static_cast<u64>(p / 100.0f * (samples.size() - 1) + 0.5f)]; };
+    return { .samples = samples.size(), .p50 = at(50), .p95 = at(95), .p99 = at(99), .max = samples.back() };
+}
+
+inline auto ghuva::write_perf_csv(std::FILE* out, std::span<perf_record const> records) -> bool
+{
+    fmt::print(out, "tick,objects,objects_copied,objects_changed,events,messages");
+    for(auto const& phase : perf_phases) fmt::print(out, ",{}", phase.name);
+    fmt::print(out, "\n");
+
+    for(auto const& r : records)
+    {
+        fmt::print(out, "{},{},{},{},{},{}", r.tick, r.objects, r.objects_copied, r.objects_changed, r.events, r.messages);
+        for(auto const& phase : perf_phases) fmt::print(out, ",{}", r.*phase.seconds);
+        fmt::print(out, "\n");
+    }
+    return std::fflush(out) == 0 && !std::ferror(out);
+}
+
+inline auto ghuva::write_perf_json(std::FILE* out, std::span<perf_record const> records) -> bool
+{
+    fmt::print(out, "[");
+    for(auto i = 0_u64; i < records.size(); ++i)
+    {
+        auto const& r = records[i];
+        fmt::print(out, "{}\n  {{ \"tick\": {}, \"objects\": {}, \"objects_copied\": {}, \"objects_changed\": {}, \"events\": {}, \"messages\": {}",
+            i == 0 ? "" : ",", r.tick, r.objects, r.objects_copied, r.objects_changed, r.events, r.messages);
+        for(auto const& phase : perf_phases) fmt::print(out, ", \"{}\": {}", phase.name, r.*phase.seconds);
+        fmt::print(out, " }}");
+    }
+    fmt::print(out, "\n]\n");
+    return std::fflush(out) == 0 && !std::ferror(out);
+}
@@ -10,4 +10,13 @@ namespace ghuva
         fpoint rot   = {0, 0, 0}; // In radians.
         fpoint scale = {1, 1, 1};
     };
+
+    // Component-wise, rot included, so only meant for the small steps between two ticks.
+    constexpr auto lerp(transform const& from, transform const& to, f32 alpha) -> transform
+    {
+        auto const mix = [alpha](fpoint const& a, fpoint const& b) -> fpoint {
+            return { a.x + (b.x - a.x) * alpha, a.y + (b.y - a.y) * alpha, a.z + (b.z - a.z) * alpha };
+        };
+        return { .pos = mix(from.pos, to.pos), .rot = mix(from.rot, to.rot), .scale = mix(from.scale, to.scale) };
+    }
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <type_traits>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <span>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "aliases.hpp"
+
+namespace ghuva::inline utils
+{
+    // A whole file mapped read-only, reading it is just touching memory
+    // and the OS only pages in what actually gets read.
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+        explicit mapped_file(char const* path);
+        mapped_file(mapped_file const&) = delete;
+        auto operator=(mapped_file const&) -> mapped_file& = delete;
+        ~mapped_file();
+
+        // False if the file couldn't be opened (or is empty).
+        explicit operator bool() const { return data != nullptr; }
+        auto bytes() const -> std::span<std::byte const> { return { static_cast<std::byte const*>(data), size }; }
+
+    private:
+        void* data = nullptr;
+        u64   size = 0;
+    };
+
+    // Writes trivially copyable stuff out as is. Every value and array starts at a multiple
+    // of its alignof from the start of the file, so a binary_reader over a mapped_file can
+    // hand out spans pointing right into it instead of copying.
+    class binary_writer
+    {
+    public:
+        explicit binary_writer(char const* path) : file{ std::fopen(path, "wb") } {}
+        binary_writer(binary_writer const&) = delete;
+        auto operator=(binary_writer const&) -> binary_writer& = delete;
+        ~binary_writer() { close(); }
+
+        template <typename T>
+        auto write(T const& value) -> binary_writer&;
+        // Count first, then the elements.
+        template <typename T>
+        auto write(std::span<T const> values) -> binary_writer&;
+        auto write(std::string_view s) -> binary_writer& { return write(std::span<char const>(s)); }
+
+        // False if anything failed so far. Check it after close() to know everything made it to disk.
+        auto ok() const -> bool { return good; }
+        auto close() -> bool;
+
+    private:
+        auto raw(void const* data, u64 size) -> void;
+        auto align(u64 alignment) -> void;
+
+        std::FILE* file;
+        u64  at   = 0;
+        bool good = file != nullptr;
+    };
+
+    // The other half of binary_writer, read things back in the order they were written.
+    // Reading past the end (or a misaligned file) makes ok() false and everything read
+    // from then on comes back zeroed/empty, so it's fine to only check once at the end.
+    struct binary_reader
+    {
+        std::span<std::byte const> data;
+        u64  at   = 0;
+        bool good = true;
+
+        template <typename T>
+        auto read() -> T;
+        template <typename T>
+        auto read_span() -> std::span<T const>;
+        auto read_string() -> std::string_view { auto const s = read_span<char>(); return { s.data(), s.size() }; }
+
+        auto ok() const -> bool { return good; }
+
+    private:
+        auto take(u64 size, u64 alignment) -> std::byte const*;
+    };
+}
+
+// Impls.
+
+inline ghuva::utils::mapped_file::mapped_file(char const* path)
+{
+    auto const fd = ::open(path, O_RDONLY);
+    if(fd < 0) return;
+
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        auto* const p = ::mmap(nullptr, static_cast<u64>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED)
+        {
+            data = p;
+            size = static_cast<u64>(st.st_size);
+        }
+    }
+    ::close(fd); // The mapping keeps the file alive by itself.
+}
+
+inline ghuva::utils::mapped_file::~mapped_file()
+{
+    if(data) ::munmap(data, size);
+}
+
+template <typename T>
+auto ghuva::utils::binary_writer::write(T const& value) -> binary_writer&
+{
+    static_assert(std::is_trivially_copyable_v<T>, "binary_writer only writes trivially copyable stuff.");
+    align(alignof(T));
+    raw(&value, sizeof(T));
+    return *this;
+}
+
+template <typename T>
+auto ghuva::utils::binary_writer::write(std::span<T const> values) -> binary_writer&
+{
+    static_assert(std::is_trivially_copyable_v<T>, "binary_writer only writes trivially copyable stuff.");
+    write(u64{ values.size() });
+    align(alignof(T));
+    raw(values.data(), values.size_bytes());
+    return *this;
+}
+
+inline auto ghuva::utils::binary_writer::close() -> bool
+{
+    if(file && std::fclose(file) != 0) good = false;
+    file = nullptr;
+    return good;
+}
+
+inline auto ghuva::utils::binary_writer::raw(void const* data, u64 size) -> void
+{
+    if(!good || size == 0) return;
+    good = std::fwrite(data, 1, size, file) == size;
+    at  += size;
+}
+
+inline auto ghuva::utils::binary_writer::align(u64 alignment) -> void
+{
+    static constexpr std::byte zeroes[64] = {};
+    raw(zeroes, (alignment - at % alignment) % alignment);
+}
+
+template <typename T>
+auto ghuva::utils::binary_reader::read() -> T
+{
+    static_assert(std::is_trivially_copyable_v<T>, "binary_reader only reads trivially copyable stuff.");
+    auto value = T{};
+    if(auto const* p = take(sizeof(T), alignof(T)); p) std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+template <typename T>
+auto ghuva::utils::binary_reader::read_span() -> std::span<T const>
+{
+    static_assert(std::is_trivially_copyable_v<T>, "binary_reader only reads trivially copyable stuff.");
+    auto const count = read<u64>();
+    if(count > data.size() / sizeof(T)) { good = false; return {}; }
+
+    auto const* p = take(count * sizeof(T), alignof(T));
+    if(!p || (reinterpret_cast<std::uintptr_t>(p) % alignof(T)) != 0) { good = false; return {}; }
+    return { reinterpret_cast<T const*>(p), count };
+}
+
+inline auto ghuva::utils::binary_reader::take(u64 size, u64 alignment) -> std::byte const*
+{
+    auto const start = at + (alignment - at % alignment) % alignment;
+    if(!good || start > data.size() || data.size() - start < size) { good = false; return nullptr; }
+    at = start + size;
+    return data.data() + start;
+}
@@ -3,12 +3,17 @@
 #include <shared_mutex>
 #include <mutex>
 
+#include "forward.hpp"
+
 namespace ghuva::inline utils
 {
     // Very simple wrapper for concurrent resources.
     template <typename T>
     struct guarded
     {
+        constexpr guarded() = default;
+        constexpr explicit guarded(T d) : data{ ghuva::move(d) } {}
+
         auto write(auto f);
         auto read(auto f) const;
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <span>
+#include <cstddef>
+
+#include "aliases.hpp"
+
+namespace ghuva::inline utils
+{
+    // FNV-1a, 64 bits. Nothing clever, just for telling data apart. Chain calls by passing
+    // the last result as hash.
+    constexpr u64 fnv1a_seed = 0xcbf2'9ce4'8422'2325;
+
+    constexpr auto fnv1a(std::span<std::byte const> bytes, u64 hash = fnv1a_seed) -> u64;
+    template <typename T>
+    constexpr auto fnv1a(std::span<T const> values, u64 hash = fnv1a_seed) -> u64 { return fnv1a(std::as_bytes(values), hash); }
+}
+
+// Impls.
+
+constexpr auto ghuva::utils::fnv1a(std::span<std::byte const> bytes, u64 hash) -> u64
+{
+    for(auto const b : bytes)
+    {
+        hash ^= static_cast<u64>(b);
+        hash *= 0x0000'0100'0000'01b3;
+    }
+    return hash;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <type_traits>
+#include <cstddef>
+#include <new>
+
+#include "remove_cvref.hpp"
+#include "aliases.hpp"
+#include "forward.hpp"
+
+namespace ghuva::inline utils
+{
+    template <typename Signature, u64 Capacity = 64>
+    class inplace_function;
+
+    // Like std::function but the callable always lives inside it, so creating, copying and
+    // moving one never allocates by itself (what the callable captures still might, of course).
+    // Callables that don't fit in Capacity bytes are a compile error.
+    template <typename R, typename... Args, u64 Capacity>
+    class inplace_function<R(Args...), Capacity>
+    {
+    public:
+        static constexpr u64 capacity = Capacity;
+
+        // The noexcepts are spelled out, GCC 12 crashes working them out when an inplace_function
+        // has a default member initializer (e.g. object::constructorargs::on_tick).
+        constexpr inplace_function() noexcept = default;
+        constexpr inplace_function(decltype(nullptr)) {}
+
+        // Callables have to be nothrow movable, moving one around can't fail halfway through.
+        template <typename F>
+            requires (!std::is_same_v< ghuva::remove_cvref_t<F>, inplace_function >)
+                  && std::is_invocable_r_v< R, ghuva::remove_cvref_t<F>&, Args... >
+        inplace_function(F&& f);
+
+        inplace_function(inplace_function const& other);
+        inplace_function(inplace_function&& other) noexcept;
+        auto operator=(inplace_function const& other) -> inplace_function&;
+        auto operator=(inplace_function&& other) noexcept -> inplace_function&;
+        ~inplace_function() noexcept { reset(); }
+
+        // Same as std::function, callables with state are called as non-const.
+        auto operator()(Args... args) const -> R { return ops->invoke(storage, ghuva::forward<Args>(args)...); }
+        explicit operator bool() const { return ops != nullptr; }
+
+    private:
+        struct ops_t
+        {
+            R    (*invoke)(void const* storage, Args&&... args);
+            void (*copy)(void* to, void const* from);
+            void (*move)(void* to, void* from);
+            void (*destroy)(void* storage);
+        };
+
+        template <typename F>
+        static constexpr ops_t ops_for = {
+            .invoke  = [](void const* s, Args&&... args) -> R { return (*static_cast<F*>(const_cast<void*>(s)))(ghuva::forward<Args>(args)...); },
+            .copy    = [](void* to, void const* from) { ::new(to) F(*static_cast<F const*>(from)); },
+            .move    = [](void* to, void* from) { ::new(to) F(ghuva::move(*static_cast<F*>(from))); },
+            .destroy = [](void* s) { static_cast<F*>(s)->~F(); },
+        };
+
+        auto reset() -> void;
+
+        alignas(std::max_align_t) mutable std::byte storage[Capacity];
+        ops_t const* ops = nullptr;
+    };
+}
+
+// Impls.
+
+template <typename R, typename... Args, ghuva::u64 C>
+template <typename F>
+    requires (!std::is_same_v< ghuva::remove_cvref_t<F>, ghuva::utils::inplace_function<R(Args...), C> >)
+          && std::is_invocable_r_v< R, ghuva::remove_cvref_t<F>&, Args... >
+ghuva::utils::inplace_function<R(Args...), C>::inplace_function(F&& f)
+{
+    using fn_t = ghuva::remove_cvref_t<F>;
+    static_assert(sizeof(fn_t)  <= C, "Callable too big for this inplace_function, capture less or raise its capacity.");
+    static_assert(alignof(fn_t) <= alignof(std::max_align_t), "Callable too aligned for inplace_function.");
+    static_assert(std::is_nothrow_move_constructible_v<fn_t>, "Callable has to be nothrow move constructible for inplace_function.");
+
+    ::new(static_cast<void*>(storage)) fn_t(ghuva::forward<F>(f));
+    ops = &ops_for<fn_t>;
+}
+
+template <typename R, typename... Args, ghuva::u64 C>
+ghuva::utils::inplace_function<R(Args...), C>::inplace_function(inplace_function const& other)
+{
+    if(other.ops) other.ops->copy(storage, other.storage);
+    ops = other.ops;
+}
+
+template <typename R, typename... Args, ghuva::u64 C>
+ghuva::utils::inplace_function<R(Args...), C>::inplace_function(inplace_function&& other) noexcept
+    : ops{ other.ops }
+{
+    if(ops) ops->move(storage, other.storage);
+}
+
+template <typename R, typename... Args, ghuva::u64 C>
+auto ghuva::utils::inplace_function<R(Args...), C>::operator=(inplace_function const& other) -> inplace_function&
+{
+    if(this == &other) return *this;
+    // Copy first, if that throws we're left as we were.
+    auto copy = other;
+    return *this = ghuva::move(copy);
+}
+
+template <typename R, typename... Args, ghuva::u64 C>
+auto ghuva::utils::inplace_function<R(Args...), C>::operator=(inplace_function&& other) noexcept -> inplace_function&
+{
+    if(this == &other) return *this;
+    reset();
+    ops = other.ops;
+    if(ops) ops->move(storage, other.storage);
+    return *this;
+}
+
+template <typename R, typename... Args, ghuva::u64 C>
+auto ghuva::utils::inplace_function<R(Args...), C>::reset() -> void
+{
+    if(ops) ops->destroy(storage);
+    ops = nullptr;
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "aliases.hpp"
+#include "forward.hpp"
+#include "cvt.hpp"
+
+namespace ghuva::inline utils
+{
+    // Persistent work-stealing thread pool for data-parallel loops.
+    //
+    // parallel_for() splits [0, count) into chunks and hands each worker a contiguous
+    // block of them. Workers eat their own block from the front and, once they run dry,
+    // steal the back half of somebody else's block. The calling thread takes part as
+    // worker 0, so a pool of N workers only spawns N-1 threads.
+    //
+    // Chunk ids follow the items, chunk c always covers items that come before the ones
+    // in chunk c+1 no matter which worker ends up running it.
+    struct job_pool
+    {
+        struct worker_perf
+        {
+            f32 busy   = 0.0f; // Seconds spent running chunks.
+            f32 idle   = 0.0f; // Seconds spent waking up, looking for work and waiting for the others.
+            u64 chunks = 0;
+            u64 steals = 0;
+        };
+
+        // Tracks how long each item takes so the chunk size can adapt between calls.
+        // Keep one of these around for each loop you run through the pool.
+        struct grain
+        {
+            f32 seconds_per_item     = 0.0f;  // Running average, 0 = unknown.
+            f32 target_chunk_seconds = 50e-6f;
+            u64 min_chunk            = 16;
+        };
+
+        struct plan_t
+        {
+            u64 chunk_size;
+            u64 chunk_count;
+        };
+
+        explicit job_pool(u32 workers = 0); // 0 = std::thread::hardware_concurrency().
+        ~job_pool();
+
+        job_pool(job_pool const&) = delete;
+        auto operator=(job_pool const&) -> job_pool& = delete;
+
+        // How the next parallel_for() with these arguments is going to be chunked.
+        // Handy for setting up per-chunk storage beforehand.
+        auto plan(u64 count, grain const& g) const -> plan_t;
+
+        // Calls f(chunk_id, begin, end, worker_id) for each chunk of [0, count)
+        // and blocks until all of them are done. Not reentrant.
+        template <typename F>
+        auto parallel_for(u64 count, grain& g, F&& f) -> void;
+
+        auto worker_count() const -> u32 { return workers; }
+
+        // Stats for the last parallel_for(), one per worker.
+        auto last_perf()        const -> std::vector<worker_perf> const& { return perf; }
+        auto last_chunk_count() const -> u64 { return current.chunk_count; }
+        auto last_chunk_size()  const -> u64 { return current.chunk_size; }
+
+    private:
+        using clock = std::chrono::high_resolution_clock;
+
+        struct alignas(64) worker_state
+        {
+            std::atomic<u64> range = 0; // Chunks [lo, hi) left to run, packed as (lo << 32) | hi.
+        };
+
+        struct job
+        {
+            u64 count       = 0;
+            u64 chunk_size  = 0;
+            u64 chunk_count = 0;
+            clock::time_point start;
+
+            void* ctx = nullptr;
+            void (*run)(void* ctx, u64 chunk, u64 begin, u64 end, u32 worker) = nullptr;
+        };
+
+        static constexpr auto pack(u64 lo, u64 hi) -> u64 { return (lo << 32) | hi; }
+        static constexpr auto lo_of(u64 r) -> u64 { return r >> 32; }
+        static constexpr auto hi_of(u64 r) -> u64 { return r & 0xffff'ffff; }
+
+        auto thread_main(u32 worker) -> void;
+        auto work(u32 worker) -> void; // Runs chunks until there are none left to pop or steal.
+        auto pop(u32 worker, u64& chunk) -> bool;
+        auto steal(u32 thief, u64& chunk) -> bool;
+        auto run_chunk(u32 worker, u64 chunk) -> void;
+        auto check_out(u32 worker) -> void; // Fills in the idle time once a worker is done.
+
+        u32 workers;
+        std::unique_ptr<worker_state[]> states;
+        std::vector<worker_perf> perf;
+        std::vector<std::jthread> threads;
+
+        job current;
+        std::atomic<u64> generation = 0; // Bumped to wake the threads up for a new job.
+        std::atomic<u32> active     = 0; // Threads that haven't checked out of the current job yet.
+        std::atomic<bool> stopping  = false;
+    };
+}
+
+// Impls.
+
+inline ghuva::utils::job_pool::job_pool(u32 w)
+    : workers{ w != 0 ? w : std::max(1u, std::thread::hardware_concurrency()) }
+    , states{ std::make_unique<worker_state[]>(workers) }
+    , perf(workers)
+{
+    threads.reserve(workers - 1);
+    for(auto i = 1_u32; i < workers; ++i) threads.emplace_back([this, i]{ thread_main(i); });
+}
+
+inline ghuva::utils::job_pool::~job_pool()
+{
+    stopping = true;
+    generation.fetch_add(1);
+    generation.notify_all();
+    threads.clear(); // Joins.
+}
+
+inline auto ghuva::utils::job_pool::plan(u64 count, grain const& g) const -> plan_t
+{
+    if(count == 0) return { .chunk_size = 0, .chunk_count = 0 };
+
+    // At least a few chunks per worker so stealing has something to balance, unless that
+    // would make them smaller than min_chunk. Within that, aim for target_chunk_seconds.
+    auto const balance_chunk = std::max<u64>(g.min_chunk, count / (workers * 4_u64));
+    auto const timed_chunk   = g.seconds_per_item > 0.0f
+        ? (g.target_chunk_seconds / g.seconds_per_item) * cvt::to<u64>
+        : balance_chunk;
+    auto const chunk_size    = std::clamp<u64>(timed_chunk, std::min(g.min_chunk, count), balance_chunk);
+
+    return { .chunk_size = chunk_size, .chunk_count = (count + chunk_size - 1) / chunk_size };
+}
+
+template <typename F>
+auto ghuva::utils::job_pool::parallel_for(u64 count, grain& g, F&& f) -> void
+{
+    for(auto& p : perf) p = {};
+    if(count == 0) { current.chunk_count = 0; return; }
+
+    auto const [chunk_size, chunk_count] = plan(count, g);
+
+    using func_t = ghuva::remove_cvref_t<F>;
+    current = {
+        .count       = count,
+        .chunk_size  = chunk_size,
+        .chunk_count = chunk_count,
+        .start       = clock::now(),
+        .ctx         = const_cast<func_t*>(&f),
+        .run         = [](void* ctx, u64 chunk, u64 begin, u64 end, u32 worker){
+            (*static_cast<func_t*>(ctx))(chunk, begin, end, worker);
+        },
+    };
+
+    auto const participants = std::min<u64>(workers, chunk_count) * cvt::to<u32>;
+    for(auto i = 0_u32; i < workers; ++i)
+    {
+        auto const lo = i < participants ? chunk_count *  i      / participants : 0;
+        auto const hi = i < participants ? chunk_count * (i + 1) / participants : 0;
+        states[i].range.store(pack(lo, hi), std::memory_order_relaxed);
+    }
+
+    if(participants > 1)
+    {
+        active.store(workers - 1, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+    }
+
+    work(0);
+
+    if(participants > 1)
+        while(active.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+    check_out(0);
+
+    // Feed the measured cost back so the next call picks a better chunk size.
+    auto busy = 0.0f;
+    for(auto const& p : perf) busy += p.busy;
+    auto const sample = busy / (count * cvt::to<f32>);
+    g.seconds_per_item = g.seconds_per_item > 0.0f ? g.seconds_per_item * 0.8f + sample * 0.2f : sample;
+}
+
+inline auto ghuva::utils::job_pool::thread_main(u32 worker) -> void
+{
+    auto seen = 0_u64;
+    while(true)
+    {
+        // Spin for a little bit first, back to back jobs (e.g. consecutive ticks) are common.
+        for(auto spins = 0; spins < 256 && generation.load(std::memory_order_acquire) == seen; ++spins)
+            std::this_thread::yield();
+        generation.wait(seen, std::memory_order_acquire);
+        seen = generation.load(std::memory_order_acquire);
+
+        if(stopping) return;
+
+        work(worker);
+        check_out(worker);
+        active.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+inline auto ghuva::utils::job_pool::work(u32 worker) -> void
+{
+    auto chunk = 0_u64;
+    while(pop(worker, chunk) || steal(worker, chunk)) run_chunk(worker, chunk);
+}
+
+inline auto ghuva::utils::job_pool::check_out(u32 worker) -> void
+{
+    auto& p = perf[worker];
+    p.idle = std::chrono::duration<f32>(clock::now() - current.start).count() - p.busy;
+}
+
+inline auto ghuva::utils::job_pool::pop(u32 worker, u64& chunk) -> bool
+{
+    auto& range = states[worker].range;
+    auto r = range.load(std::memory_order_acquire);
+    while(lo_of(r) < hi_of(r))
+    {
+        if(range.compare_exchange_weak(r, pack(lo_of(r) + 1, hi_of(r)), std::memory_order_acq_rel))
+        {
+            chunk = lo_of(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE: Chunks are only ever handed out once and a worker only
+//       stores into its own range while it is empty, so a
+//       stale (lo, hi) can't reappear and trick a thief's CAS.
+inline auto ghuva::utils::job_pool::steal(u32 thief, u64& chunk) -> bool
+{
+    for(auto i = 1_u32; i < workers; ++i)
+    {
+        auto& range = states[(thief + i) % workers].range;
+        auto r = range.load(std::memory_order_acquire);
+        while(lo_of(r) < hi_of(r))
+        {
+            auto const lo   = lo_of(r);
+            auto const hi   = hi_of(r);
+            auto const take = (hi - lo + 1) / 2; // The back half, rounded up.
+            if(range.compare_exchange_weak(r, pack(lo, hi - take), std::memory_order_acq_rel))
+            {
+                chunk = hi - take;
+                states[thief].range.store(pack(chunk + 1, hi), std::memory_order_release);
+                ++perf[thief].steals;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+inline auto ghuva::utils::job_pool::run_chunk(u32 worker, u64 chunk) -> void
+{
+    auto const begin = chunk * current.chunk_size;
+    auto const end   = std::min(begin + current.chunk_size, current.count);
+
+    auto const t1 = clock::now();
+    current.run(current.ctx, chunk, begin, end, worker);
+    auto const t2 = clock::now();
+
+    auto& p = perf[worker];
+    p.busy += std::chrono::duration<f32>(t2 - t1).count();
+    ++p.chunks;
+}
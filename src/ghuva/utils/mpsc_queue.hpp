@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+
+#include "aliases.hpp"
+#include "forward.hpp"
+
+namespace ghuva::inline utils
+{
+    // Lock-free multiple producer, single consumer queue.
+    // Producers push() from whatever thread, the consumer takes everything in one go with drain().
+    // It's a linked stack under the hood so each push allocates a node, keep the values small-ish.
+    template <typename T>
+    struct mpsc_queue
+    {
+        using value_type = T;
+
+        constexpr mpsc_queue() = default;
+        mpsc_queue(mpsc_queue const&) = delete;
+        auto operator=(mpsc_queue const&) -> mpsc_queue& = delete;
+        ~mpsc_queue() { drain([](T&&){}); }
+
+        auto push(T value) -> void;
+
+        // Calls f(T&&) with everything pushed so far, oldest first. Only one thread may drain at a time.
+        // Returns how many there were.
+        template <typename F>
+        auto drain(F&& f) -> u64;
+
+    private:
+        struct node
+        {
+            T     value;
+            node* next;
+        };
+
+        std::atomic<node*> head = nullptr; // Newest first.
+    };
+}
+
+// Impls.
+
+template <typename T>
+auto ghuva::utils::mpsc_queue<T>::push(T value) -> void
+{
+    auto* n = new node{ .value = ghuva::move(value), .next = head.load(std::memory_order_relaxed) };
+    while(!head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <typename T>
+template <typename F>
+auto ghuva::utils::mpsc_queue<T>::drain(F&& f) -> u64
+{
+    auto* n = head.exchange(nullptr, std::memory_order_acquire);
+
+    // Flip it so the oldest comes first.
+    node* oldest = nullptr;
+    while(n)
+    {
+        auto* next = n->next;
+        n->next = oldest;
+        oldest  = n;
+        n       = next;
+    }
+
+    auto count = 0_u64;
+    while(oldest)
+    {
+        auto* next = oldest->next;
+        f(ghuva::move(oldest->value));
+        delete oldest;
+        oldest = next;
+        ++count;
+    }
+    return count;
+}
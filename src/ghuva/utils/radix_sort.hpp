@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "job_pool.hpp"
+#include "aliases.hpp"
+
+namespace ghuva::inline utils
+{
+    // What actually gets sorted, index is where the element was before sorting.
+    // Sort these and then move your elements around, way cheaper than shuffling fat elements 8 times.
+    struct radix_item
+    {
+        u64 key;
+        u64 index;
+    };
+
+    // Stable LSD radix sort by key, 8 bits at a time. Bytes that are the same in every key
+    // are skipped, so small keys (like object ids) only take a couple of passes.
+    // If a pool is given, the histograms and scatters of each pass are split across it.
+    inline auto radix_sort(std::vector<radix_item>& items, std::vector<radix_item>& scratch, job_pool* pool = nullptr) -> void;
+}
+
+// Impls.
+
+inline auto ghuva::utils::radix_sort(std::vector<radix_item>& items, std::vector<radix_item>& scratch, job_pool* pool) -> void
+{
+    auto const count = items.size();
+    if(count < 2) return;
+
+    auto varying = 0_u64;
+    for(auto const& it : items) varying |= it.key ^ items[0].key;
+    if(varying == 0) return;
+
+    scratch.resize(count);
+
+    // Big enough chunks that the per-chunk histograms don't cost more than the sorting.
+    auto const workers    = pool ? pool->worker_count() : 1_u32;
+    auto const chunk_size = std::max<u64>(4096, (count + workers * 4_u64 - 1) / (workers * 4_u64));
+    auto const chunks     = (count + chunk_size - 1) / chunk_size;
+    auto const run = [&](auto&& f){
+        if(!pool || chunks == 1) { for(auto c = 0_u64; c < chunks; ++c) f(c, c * chunk_size, std::min(count, (c + 1) * chunk_size)); return; }
+
+        // A fresh grain each time so the pool chunks things exactly like we do.
+        auto g = job_pool::grain{ .min_chunk = chunk_size };
+        pool->parallel_for(count, g, [&](u64 c, u64 begin, u64 end, u32){ f(c, begin, end); });
+    };
+
+    using histogram = std::array<u64, 256>;
+    auto histograms = std::vector<histogram>(chunks);
+
+    for(auto shift = 0_u64; shift < 64; shift += 8)
+    {
+        if(((varying >> shift) & 0xff) == 0) continue;
+
+        run([&](u64 c, u64 begin, u64 end){
+            auto& h = histograms[c];
+            h.fill(0);
+            for(auto i = begin; i < end; ++i) ++h[(items[i].key >> shift) & 0xff];
+        });
+
+        // Turn the counts into where each chunk starts writing each digit,
+        // digit major so the result stays stable.
+        auto offset = 0_u64;
+        for(auto digit = 0; digit < 256; ++digit)
+            for(auto& h : histograms)
+            {
+                auto const n = h[digit];
+                h[digit] = offset;
+                offset  += n;
+            }
+
+        run([&](u64 c, u64 begin, u64 end){
+            auto& h = histograms[c];
+            for(auto i = begin; i < end; ++i) scratch[h[(items[i].key >> shift) & 0xff]++] = items[i];
+        });
+
+        items.swap(scratch);
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <map>
+
+#include "aliases.hpp"
+
+namespace ghuva::inline utils
+{
+    // Hands out ranges of [0, capacity) that stay put until freed, e.g. spots in a GPU
+    // buffer. First fit over a free list kept sorted by offset, freed ranges get merged
+    // back with their neighbours. Units are whatever you want them to be, it only does
+    // the bookkeeping.
+    //
+    // It doesn't move anything around by itself, when it gets too fragmented to fit
+    // something that would otherwise fit the way out is to reset() and allocate
+    // everything again (see fragmented()).
+    class range_allocator
+    {
+    public:
+        struct range
+        {
+            u64 offset = 0;
+            u64 size   = 0;
+        };
+
+        explicit range_allocator(u64 capacity = 0) { reset(capacity); }
+
+        // Always a multiple of alignment, nullopt if there's no free range big enough.
+        auto allocate(u64 size, u64 alignment = 1) -> std::optional<range>;
+        auto free(range r) -> void; // Has to be exactly what allocate() gave.
+        auto reset(u64 capacity) -> void; // Frees everything.
+        auto grow(u64 capacity) -> void; // Only ever grows, everything allocated stays put.
+
+        auto capacity() const -> u64 { return total; }
+        auto used()     const -> u64 { return in_use; }
+        auto end()      const -> u64; // Past the last allocated unit, what actually needs to be in the buffer.
+        auto largest_free() const -> u64;
+        // There's room for size but not in one piece.
+        auto fragmented(u64 size) const -> bool { return total - in_use >= size && largest_free() < size; }
+
+    private:
+        auto insert_free(range r) -> void; // Merging it with its neighbours.
+
+        u64 total  = 0;
+        u64 in_use = 0;
+        std::map<u64, u64> free_ranges; // Offset -> size, never touching each other.
+    };
+}
+
+// Impls.
+
+inline auto ghuva::utils::range_allocator::allocate(u64 size, u64 alignment) -> std::optional<range>
+{
+    if(size == 0) return range{ .offset = 0, .size = 0 };
+
+    for(auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+    {
+        auto const [offset, free_size] = *it;
+        auto const aligned = (offset + alignment - 1) / alignment * alignment;
+        if(aligned + size > offset + free_size) continue;
+
+        // Carve it out, leaving whatever's left on either side free.
+        free_ranges.erase(it);
+        if(aligned > offset) free_ranges.emplace(offset, aligned - offset);
+        if(aligned + size < offset + free_size) free_ranges.emplace(aligned + size, offset + free_size - aligned - size);
+
+        in_use += size;
+        return range{ .offset = aligned, .size = size };
+    }
+    return std::nullopt;
+}
+
+inline auto ghuva::utils::range_allocator::free(range r) -> void
+{
+    if(r.size == 0) return;
+    in_use -= r.size;
+    insert_free(r);
+}
+
+inline auto ghuva::utils::range_allocator::insert_free(range r) -> void
+{
+    auto next = free_ranges.lower_bound(r.offset);
+    if(next != free_ranges.end() && r.offset + r.size == next->first)
+    {
+        r.size += next->second;
+        next = free_ranges.erase(next);
+    }
+    if(next != free_ranges.begin())
+    {
+        auto const prev = std::prev(next);
+        if(prev->first + prev->second == r.offset)
+        {
+            prev->second += r.size;
+            return;
+        }
+    }
+    free_ranges.emplace_hint(next, r.offset, r.size);
+}
+
+inline auto ghuva::utils::range_allocator::reset(u64 capacity) -> void
+{
+    total  = capacity;
+    in_use = 0;
+    free_ranges.clear();
+    if(capacity) free_ranges.emplace(0, capacity);
+}
+
+inline auto ghuva::utils::range_allocator::grow(u64 capacity) -> void
+{
+    if(capacity <= total) return;
+    insert_free(range{ .offset = total, .size = capacity - total });
+    total = capacity;
+}
+
+inline auto ghuva::utils::range_allocator::end() const -> u64
+{
+    if(free_ranges.empty()) return total;
+    auto const& [offset, size] = *free_ranges.rbegin();
+    return offset + size == total ? offset : total;
+}
+
+inline auto ghuva::utils::range_allocator::largest_free() const -> u64
+{
+    auto largest = 0_u64;
+    for(auto const& [offset, size] : free_ranges) largest = std::max(largest, size);
+    return largest;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <type_traits>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <array>
+#include <cstring>
+
+#include "aliases.hpp"
+
+namespace ghuva::inline utils
+{
+    // Fixed-size ring of the last few T pushed, one writer and any number of readers.
+    // Nobody ever waits on anybody: each slot has a sequence number the writer bumps
+    // before and after writing it, readers copy a slot and then check it didn't change
+    // under them, dropping it if it did. Meant for small T that get pushed often and
+    // read every now and then.
+    template <typename T>
+    class seqlock_ring
+    {
+    public:
+        static_assert(std::is_trivially_copyable_v<T>, "seqlock_ring copies T around byte by byte.");
+
+        // capacity gets rounded up to a power of 2.
+        explicit seqlock_ring(u64 capacity);
+
+        // Only ever from one thread at a time.
+        auto push(T const& value) -> void;
+
+        // Appends up to count of the most recent values to out, oldest first. Values
+        // overwritten while reading are left out, so it may come back with fewer.
+        auto read_latest(u64 count, std::vector<T>& out) const -> void;
+
+        auto capacity() const -> u64 { return mask + 1; }
+        auto pushed()   const -> u64 { return head.load(std::memory_order_acquire); }
+
+    private:
+        static constexpr u64 words = (sizeof(T) + sizeof(u64) - 1) / sizeof(u64);
+
+        struct slot
+        {
+            std::atomic<u64> seq = 0; // 2n + 1 while the nth value is being written, 2n + 2 once it's there.
+            std::array<std::atomic<u64>, words> data = {};
+        };
+
+        u64 mask;
+        std::unique_ptr<slot[]> slots;
+        std::atomic<u64> head = 0; // How many were pushed so far.
+    };
+}
+
+// Impls.
+
+template <typename T>
+ghuva::utils::seqlock_ring<T>::seqlock_ring(u64 capacity)
+{
+    auto size = 1_u64;
+    while(size < capacity) size *= 2;
+    mask  = size - 1;
+    slots = std::make_unique<slot[]>(size);
+}
+
+template <typename T>
+auto ghuva::utils::seqlock_ring<T>::push(T const& value) -> void
+{
+    auto buffer = std::array<u64, words>{};
+    std::memcpy(buffer.data(), &value, sizeof(T));
+
+    auto const n = head.load(std::memory_order_relaxed);
+    auto& s = slots[n & mask];
+    s.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // Readers see the odd seq before any of the new data.
+    for(auto i = 0_u64; i < words; ++i) s.data[i].store(buffer[i], std::memory_order_relaxed);
+    s.seq.store(2 * n + 2, std::memory_order_release);
+    head.store(n + 1, std::memory_order_release);
+}
+
+template <typename T>
+auto ghuva::utils::seqlock_ring<T>::read_latest(u64 count, std::vector<T>& out) const -> void
+{
+    auto const end   = head.load(std::memory_order_acquire);
+    auto const first = end - std::min({ count, end, capacity() });
+
+    auto buffer = std::array<u64, words>{};
+    for(auto n = first; n < end; ++n)
+    {
+        auto const& s = slots[n & mask];
+        if(s.seq.load(std::memory_order_acquire) != 2 * n + 2) continue; // Already overwritten.
+        for(auto i = 0_u64; i < words; ++i) buffer[i] = s.data[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire); // The copy is done before checking seq again.
+        if(s.seq.load(std::memory_order_relaxed) != 2 * n + 2) continue; // Got overwritten while copying.
+
+        auto value = T{};
+        std::memcpy(&value, buffer.data(), sizeof(T));
+        out.push_back(value);
+    }
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <span>
+
+#include "aliases.hpp"
+#include "forward.hpp"
+
+namespace ghuva::inline utils
+{
+    // Values packed densely in insertion order (so iterating them is just walking an array)
+    // plus a table of slots pointing into them, so handing out keys that survive the values
+    // being moved around. insert(), erase() and find() are all O(1).
+    //
+    // Keys are (generation << 32) | (slot + 1), so 0 is never a valid key and the first keys
+    // handed out are 1, 2, 3... Erasing bumps the slot's generation so old keys to it go stale
+    // instead of pointing at whatever gets put there next.
+    //
+    // Erasing moves the last value into the hole, so it does NOT keep the order.
+    template <typename T>
+    struct slot_map
+    {
+        using key_t = u64;
+        static constexpr u64 npos = ~0_u64;
+
+        constexpr auto insert(T value) -> key_t;
+        // Appends count copies of value on brand new slots, so their keys are
+        // first, first + 1, ..., first + count - 1. Returns first.
+        constexpr auto append(u64 count, T const& value) -> key_t;
+        constexpr auto erase(key_t key) -> bool; // False if the key was stale/invalid.
+        constexpr auto swap(u64 index_a, u64 index_b) -> void; // Swaps two values around, their keys stay valid.
+        constexpr auto clear() -> slot_map&;
+        constexpr auto reserve(u64 count) -> slot_map&;
+
+        constexpr auto contains(key_t key) const -> bool { return index_of(key) != npos; }
+        constexpr auto index_of(key_t key) const -> u64; // Index into the dense values, npos if not found.
+        constexpr auto key_at(u64 index)   const -> key_t;
+
+        constexpr auto find(key_t key)       -> T*;       // nullptr if not found.
+        constexpr auto find(key_t key) const -> T const*;
+
+        constexpr auto operator[](u64 index)       -> T&       { return values[index]; }
+        constexpr auto operator[](u64 index) const -> T const& { return values[index]; }
+
+        constexpr auto size()  const -> u64  { return values.size(); }
+        constexpr auto empty() const -> bool { return values.empty(); }
+
+        constexpr auto begin()       { return values.begin(); }
+        constexpr auto end()         { return values.end(); }
+        constexpr auto begin() const { return values.begin(); }
+        constexpr auto end()   const { return values.end(); }
+        constexpr auto back()       -> T&       { return values.back(); }
+        constexpr auto back() const -> T const& { return values.back(); }
+
+        // Makes this equal to from, only copying the values that aren't already there.
+        // A value is kept if it has the same key at the same index in both and
+        // changed(from_value) says no. Returns how many values were copied.
+        template <typename F>
+        constexpr auto catch_up(slot_map const& from, F&& changed) -> u64;
+        // Same, for when both are known to have the same keys at the same indexes already: the
+        // bookkeeping is left as is and only the values of keys get looked at, O(keys).
+        template <typename F>
+        constexpr auto catch_up(slot_map const& from, std::span<key_t const> keys, F&& changed) -> u64;
+
+        struct slot
+        {
+            u32 index;      // Into values while alive, next free slot otherwise.
+            u32 generation;
+        };
+        static constexpr u32 no_slot = ~0_u32;
+
+        // The bookkeeping as is, for saving it somewhere and restoring it later with
+        // every key intact. restore() leaves size() default constructed values behind,
+        // filling them in is up to you. False (and empty) if it doesn't add up.
+        constexpr auto raw_value_slots() const -> std::span<u32 const>  { return value_slots; }
+        constexpr auto raw_slots()       const -> std::span<slot const> { return slots; }
+        constexpr auto raw_free_head()   const -> u32                   { return free_head; }
+        constexpr auto restore(std::span<u32 const> value_slots, std::span<slot const> slots, u32 free_head) -> bool;
+
+    private:
+
+        static constexpr auto make_key(u32 slot, u32 generation) -> key_t { return (u64{generation} << 32) | (slot + 1_u64); }
+        static constexpr auto slot_of(key_t key)       -> u32 { return static_cast<u32>(key & 0xffff'ffff) - 1; }
+        static constexpr auto generation_of(key_t key) -> u32 { return static_cast<u32>(key >> 32); }
+
+        std::vector<T>    values;
+        std::vector<u32>  value_slots; // Parallel to values, which slot points at each one.
+        std::vector<slot> slots;
+        u32 free_head = no_slot;
+    };
+}
+
+// Impls.
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::insert(T value) -> key_t
+{
+    auto s = free_head;
+    if(s != no_slot) { free_head = slots[s].index; }
+    else
+    {
+        s = static_cast<u32>(slots.size());
+        slots.push_back({ .index = 0, .generation = 0 });
+    }
+
+    slots[s].index = static_cast<u32>(values.size());
+    values.push_back(ghuva::move(value));
+    value_slots.push_back(s);
+    return make_key(s, slots[s].generation);
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::append(u64 count, T const& value) -> key_t
+{
+    auto const first_slot  = static_cast<u32>(slots.size());
+    auto const first_value = static_cast<u32>(values.size());
+
+    values.resize(values.size() + count, value);
+    value_slots.reserve(value_slots.size() + count);
+    slots.reserve(slots.size() + count);
+    for(auto i = 0_u32; i < count; ++i)
+    {
+        value_slots.push_back(first_slot + i);
+        slots.push_back({ .index = first_value + i, .generation = 0 });
+    }
+    return make_key(first_slot, 0);
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::erase(key_t key) -> bool
+{
+    auto const index = index_of(key);
+    if(index == npos) return false;
+
+    // Fill the hole with the last value.
+    auto const last = values.size() - 1;
+    if(index != last)
+    {
+        values[index]      = ghuva::move(values[last]);
+        value_slots[index] = value_slots[last];
+        slots[value_slots[index]].index = static_cast<u32>(index);
+    }
+    values.pop_back();
+    value_slots.pop_back();
+
+    // Slots that ran out of generations are just never reused.
+    auto& s = slots[slot_of(key)];
+    if(++s.generation != 0)
+    {
+        s.index   = free_head;
+        free_head = slot_of(key);
+    }
+    return true;
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::swap(u64 a, u64 b) -> void
+{
+    if(a == b) return;
+    std::swap(values[a], values[b]);
+    std::swap(value_slots[a], value_slots[b]);
+    slots[value_slots[a]].index = static_cast<u32>(a);
+    slots[value_slots[b]].index = static_cast<u32>(b);
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::clear() -> slot_map&
+{
+    values.clear();
+    value_slots.clear();
+    slots.clear();
+    free_head = no_slot;
+    return *this;
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::reserve(u64 count) -> slot_map&
+{
+    values.reserve(count);
+    value_slots.reserve(count);
+    slots.reserve(count);
+    return *this;
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::index_of(key_t key) const -> u64
+{
+    if(key == 0) return npos;
+    auto const s = slot_of(key);
+    if(s >= slots.size() || slots[s].generation != generation_of(key)) return npos;
+
+    // Free slots keep their generation until erased again, so double check it's alive.
+    auto const index = slots[s].index;
+    if(index >= value_slots.size() || value_slots[index] != s) return npos;
+    return index;
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::key_at(u64 index) const -> key_t
+{
+    auto const s = value_slots[index];
+    return make_key(s, slots[s].generation);
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::find(key_t key) -> T*
+{
+    auto const index = index_of(key);
+    return index != npos ? &values[index] : nullptr;
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::find(key_t key) const -> T const*
+{
+    auto const index = index_of(key);
+    return index != npos ? &values[index] : nullptr;
+}
+
+template <typename T>
+template <typename F>
+constexpr auto ghuva::utils::slot_map<T>::catch_up(slot_map const& from, F&& changed) -> u64
+{
+    auto& dst = values;
+    auto const& src = from.values;
+
+    if(dst.size() > src.size()) dst.erase(dst.begin() + src.size(), dst.end());
+
+    auto copied = 0_u64;
+    for(auto i = 0_u64; i < dst.size(); ++i)
+    {
+        auto const same_key = value_slots[i] == from.value_slots[i]
+                           && slots[value_slots[i]].generation == from.slots[from.value_slots[i]].generation;
+        if(same_key && !changed(src[i])) continue;
+        dst[i] = src[i];
+        ++copied;
+    }
+    copied += src.size() - dst.size();
+    dst.insert(dst.end(), src.begin() + dst.size(), src.end());
+
+    // The bookkeeping is small and trivially copyable, just take all of it.
+    value_slots = from.value_slots;
+    slots       = from.slots;
+    free_head   = from.free_head;
+    return copied;
+}
+
+template <typename T>
+template <typename F>
+constexpr auto ghuva::utils::slot_map<T>::catch_up(slot_map const& from, std::span<key_t const> keys, F&& changed) -> u64
+{
+    auto copied = 0_u64;
+    for(auto const key : keys)
+    {
+        auto const index = from.index_of(key);
+        if(index == npos || !changed(from.values[index])) continue;
+        values[index] = from.values[index];
+        ++copied;
+    }
+    return copied;
+}
+
+template <typename T>
+constexpr auto ghuva::utils::slot_map<T>::restore(std::span<u32 const> from_value_slots, std::span<slot const> from_slots, u32 from_free_head) -> bool
+{
+    clear();
+
+    // Every slot has to be either alive, pointing back at its value, or on the free chain
+    // exactly once, anything else and index_of() or insert() would go wrong sooner or later.
+    auto taken = std::vector<bool>(from_slots.size());
+    for(auto i = 0_u64; i < from_value_slots.size(); ++i)
+    {
+        auto const s = from_value_slots[i];
+        if(s >= from_slots.size() || from_slots[s].index != i) return false;
+        taken[s] = true;
+    }
+    auto free_count = 0_u64;
+    for(auto s = from_free_head; s != no_slot; s = from_slots[s].index, ++free_count)
+    {
+        if(s >= from_slots.size() || taken[s]) return false;
+        taken[s] = true;
+    }
+    if(from_value_slots.size() + free_count != from_slots.size()) return false;
+
+    value_slots.assign(from_value_slots.begin(), from_value_slots.end());
+    slots.assign(from_slots.begin(), from_slots.end());
+    free_head = from_free_head;
+    values.resize(value_slots.size());
+    return true;
+}
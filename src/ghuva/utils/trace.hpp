@@ -0,0 +1,205 @@
+// Scoped zones on a timeline across threads, written out as Chrome trace_event JSON
+// (opens in chrome://tracing and ui.perfetto.dev). Use like:
+//     auto do_stuff() -> void
+//     {
+//         GHUVA_TRACE_ZONE("do_stuff");
+//         ...
+//     }
+// Zones are compiled out unless GHUVA_TRACE is defined (the meson `trace` option), and even
+// then they only get recorded between trace::start() and trace::stop(). When not recording
+// a zone is a relaxed atomic load.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "chrono.hpp"
+#include "aliases.hpp"
+#include "forward.hpp"
+
+namespace ghuva::trace
+{
+    #if defined(GHUVA_TRACE)
+        constexpr bool compiled_in = true;
+    #else
+        constexpr bool compiled_in = false;
+    #endif
+
+    using clock = std::chrono::steady_clock;
+
+    struct zone_record
+    {
+        char const* name; // Has to outlive the trace, string literals are fine.
+        clock::time_point begin;
+        clock::time_point end;
+    };
+
+    auto start() -> void;
+    auto stop() -> void;
+    auto recording() -> bool;
+
+    // Shows up as the name of the calling thread's track.
+    auto set_thread_name(std::string name) -> void;
+
+    // Everything recorded so far, from all threads, as trace_event JSON. Recording can go on
+    // meanwhile. False if writing failed.
+    auto write_json(std::string const& path) -> bool;
+
+    // Records itself when it goes out of scope, if recording was on when it was created.
+    class zone
+    {
+    public:
+        explicit zone(char const* name) { if(recording()) { this->name = name; stopwatch.emplace(); } }
+        zone(zone const&) = delete;
+        auto operator=(zone const&) -> zone& = delete;
+        ~zone();
+
+    private:
+        char const* name = nullptr;
+        std::optional< ghuva::chrono::stopwatch<clock> > stopwatch;
+    };
+
+    namespace impl
+    {
+        // Only its own thread writes to it and only write_json() reads from it, so neither
+        // ever waits on the other. When full, new zones get dropped until the next flush.
+        struct thread_buffer
+        {
+            static constexpr u64 capacity = 1 << 16;
+
+            auto push(zone_record const& r) -> void;
+            template <typename F> auto flush(F&& f) -> void;
+
+            std::string name;
+            u64 tid = 0;
+            std::unique_ptr<zone_record[]> records = std::make_unique<zone_record[]>(capacity);
+            std::atomic<u64> written = 0;
+            std::atomic<u64> flushed = 0;
+            std::atomic<u64> dropped = 0;
+        };
+
+        inline std::atomic<bool> is_recording = false;
+        inline clock::time_point const epoch = clock::now(); // Timestamps are relative to this.
+
+        // Buffers stay around after their thread is gone so nothing it recorded gets lost.
+        inline std::mutex registry_mutex;
+        inline std::vector< std::unique_ptr<thread_buffer> > registry;
+        inline thread_local thread_buffer* local = nullptr;
+
+        auto local_buffer() -> thread_buffer&;
+
+        // Names can be anything, so quotes, backslashes and control characters get escaped.
+        auto json_escaped(std::string_view s) -> std::string;
+    }
+}
+
+#if defined(GHUVA_TRACE)
+    #define GHUVA_TRACE_CONCAT_IMPL(a, b) a##b
+    #define GHUVA_TRACE_CONCAT(a, b) GHUVA_TRACE_CONCAT_IMPL(a, b)
+    #define GHUVA_TRACE_ZONE(name) ::ghuva::trace::zone GHUVA_TRACE_CONCAT(ghuva_trace_zone_, __LINE__){ name }
+#else
+    #define GHUVA_TRACE_ZONE(name) static_cast<void>(0)
+#endif
+
+// Impls.
+
+inline auto ghuva::trace::start() -> void { impl::is_recording.store(true, std::memory_order_relaxed); }
+
+inline auto ghuva::trace::stop() -> void { impl::is_recording.store(false, std::memory_order_relaxed); }
+
+inline auto ghuva::trace::recording() -> bool { return impl::is_recording.load(std::memory_order_relaxed); }
+
+inline auto ghuva::trace::set_thread_name(std::string name) -> void
+{
+    auto& buffer = impl::local_buffer();
+    auto const lock = std::scoped_lock{ impl::registry_mutex };
+    buffer.name = ghuva::move(name);
+}
+
+inline ghuva::trace::zone::~zone()
+{
+    if(name) impl::local_buffer().push({ .name = name, .begin = stopwatch->start_point(), .end = clock::now() });
+}
+
+inline auto ghuva::trace::impl::local_buffer() -> thread_buffer&
+{
+    if(local) return *local;
+
+    auto const lock = std::scoped_lock{ registry_mutex };
+    auto& buffer = registry.emplace_back(std::make_unique<thread_buffer>());
+    buffer->tid  = registry.size();
+    buffer->name = fmt::format("Thread {}", buffer->tid);
+    return *(local = buffer.get());
+}
+
+inline auto ghuva::trace::impl::thread_buffer::push(zone_record const& r) -> void
+{
+    auto const w = written.load(std::memory_order_relaxed);
+    if(w - flushed.load(std::memory_order_acquire) >= capacity) { dropped.fetch_add(1, std::memory_order_relaxed); return; }
+
+    records[w % capacity] = r;
+    written.store(w + 1, std::memory_order_release);
+}
+
+inline auto ghuva::trace::impl::json_escaped(std::string_view s) -> std::string
+{
+    auto escaped = std::string{};
+    escaped.reserve(s.size());
+    for(auto const c : s)
+    {
+        if(c == '"' || c == '\\')                     { escaped += '\\'; escaped += c; }
+        else if(static_cast<unsigned char>(c) < 0x20) { escaped += fmt::format("\\u{:04x}", static_cast<unsigned>(c)); }
+        else                                          { escaped += c; }
+    }
+    return escaped;
+}
+
+template <typename F>
+auto ghuva::trace::impl::thread_buffer::flush(F&& f) -> void
+{
+    auto const end = written.load(std::memory_order_acquire);
+    for(auto i = flushed.load(std::memory_order_relaxed); i < end; ++i) f(records[i % capacity]);
+    flushed.store(end, std::memory_order_release);
+}
+
+// Complete ("X") events, timestamps in microseconds since the program started. Flushed buffers are
+// empty again, so each call writes out only what was recorded since the last one.
+inline auto ghuva::trace::write_json(std::string const& path) -> bool
+{
+    auto* const out = std::fopen(path.c_str(), "w");
+    if(!out) return false;
+
+    auto const us = [](clock::duration d){ return std::chrono::duration<double, std::micro>(d).count(); };
+
+    auto const lock = std::scoped_lock{ impl::registry_mutex };
+    auto first = true;
+    auto const separator = [&]{ auto const s = first ? "\n" : ",\n"; first = false; return s; };
+
+    fmt::print(out, "{{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for(auto const& buffer : impl::registry)
+    {
+        fmt::print(out, "{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+            separator(), buffer->tid, impl::json_escaped(buffer->name));
+        buffer->flush([&](zone_record const& r){
+            fmt::print(out, "{}{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                separator(), impl::json_escaped(r.name), buffer->tid, us(r.begin - impl::epoch), us(r.end - r.begin));
+        });
+        if(auto const dropped = buffer->dropped.exchange(0, std::memory_order_relaxed); dropped)
+            fmt::print(out, "{}{{\"name\": \"dropped {} zones\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}}}",
+                separator(), dropped, buffer->tid, us(clock::now() - impl::epoch));
+    }
+    fmt::print(out, "\n]}}\n");
+
+    auto const ok = !std::ferror(out);
+    return std::fclose(out) == 0 && ok;
+}
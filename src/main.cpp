@@ -1,9 +1,16 @@
 #include <fmt/core.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <random>
 #include <thread>
 #include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstdio>
+#include <unordered_map>
 
 // Unused for now.
 //#include <rapidobj/rapidobj.hpp>
@@ -13,6 +20,11 @@
 #include "ghuva/objects/ew.hpp"
 #include "ghuva/utils/math.hpp"
 #include "ghuva/utils/cvt.hpp"
+#include "ghuva/utils/hash.hpp"
+#include "ghuva/utils/chrono.hpp"
+#include "ghuva/utils/trace.hpp"
+#include "ghuva/event_log.hpp"
+#include "ghuva/perf_history.hpp"
 #include "ghuva/engine.hpp"
 
 #include "app.hpp"
@@ -33,18 +45,53 @@ struct userdata
     u64 last_snapshot_tick = 0; // To keep track of how many ticks elapsed.
 
     // Since we need to have these survive more than 1 frame.
-    std::vector<app::object> rendered_objs;
-    std::vector<g::mesh>     meshes;
+    std::vector<g::mesh>     meshes; // app sorts these in place so we keep our own copy.
+    u64 meshes_changed_at = 0;
+
+    // What app gets told changed since last_snapshot_tick, from the snapshot deltas.
+    std::vector<app::object>     changed_objs;
+    std::vector<u64>             deleted_objs;
+    std::unordered_map<u64, u64> changed_index; // Object id -> index in changed_objs.
+    bool                         objs_reset = true;
 
     auto engine_tick(bool dedicated_thread) -> void;
+    auto sync_objects(engine_t::snapshot_pair const& frame) -> void;
     auto engine_load_scene() -> void;
 
 private:
     auto engine_thread_start_ticking() -> void;
 };
 
-int main()
+auto replay(std::string const& log_path, std::optional<std::string> const& perf_path) -> int;
+auto dump_perf_history(userdata::engine_t const& engine, std::string const& path) -> void;
+auto start_trace() -> void;
+auto write_trace(std::string const& path) -> void;
+
+// --record <log>: logs everything posted to the engine from outside (the UI, mostly) while running.
+// --replay <log> [--perf <csv>]: runs a recording through the engine without a window, as fast as it
+//                                goes, and prints a checksum of the run. --perf also writes per-tick perf.
+// --perf-history <csv or json>: dumps the engine's perf history on exit, with percentiles on stdout.
+// --trace <json>: records trace zones for the whole run and writes them out on exit, for
+//                 chrome://tracing or ui.perfetto.dev. Needs a build with the meson `trace` option.
+int main(int argc, char** argv)
 {
+    auto const args = std::vector<std::string_view>(argv + 1, argv + argc);
+    auto const arg  = [&](std::string_view name) -> std::optional<std::string> {
+        auto const it = std::find(args.begin(), args.end(), name);
+        if(it == args.end() || it + 1 == args.end()) return std::nullopt;
+        return std::string(*(it + 1));
+    };
+
+    auto const trace_path = arg("--trace");
+    if(trace_path) start_trace();
+
+    if(auto const log_path = arg("--replay"); log_path)
+    {
+        auto const ret = replay(*log_path, arg("--perf"));
+        if(trace_path) write_trace(*trace_path);
+        return ret;
+    }
+
     auto app = ::app{};
 
     // TODO: print something useful instead of just exiting.
@@ -54,19 +101,28 @@ int main()
     auto ud = ::userdata{};
     ud.engine_load_scene();
 
+    // Started after loading the scene, replays load it themselves.
+    auto recorder = std::optional< g::event_recorder<userdata::engine_t> >{};
+    if(auto const log_path = arg("--record"); log_path)
+    {
+        recorder.emplace(ud.engine, *log_path);
+        fmt::print("[main] Recording events to {}\n", *log_path);
+    }
+
     app.loop(&ud, [](::app& app, [[maybe_unused]] f32 dt, auto* _ud)
     {
         auto& ud      = *(_ud * g::cvt::rc<userdata*>);
-        // TODO: query only the snapshot id, if new_id > ud.last_snapshot_id we actually take it.
 
         // We communicate engine config updates first otherwise they may be lost between ticks.
         if(app.outputs.do_engine_config_update)
         {
             fmt::print(
-                "[main] Requesting Engine to update time_multiplier to {}, tps to {} and parallel_ticking to {}\n",
+                "[main] Requesting Engine to update time_multiplier to {}, tps to {}, parallel_ticking to {}, job_pool to {} and tick_workers to {}\n",
                 app.outputs.target_time_multiplier,
                 app.outputs.target_tps,
-                app.outputs.parallel_ticking
+                app.outputs.parallel_ticking,
+                app.outputs.job_pool,
+                app.outputs.tick_workers
             );
 
             using e = userdata::engine_t;
@@ -74,10 +130,22 @@ int main()
             ud.engine.post(e::set_time_multiplier{ .time_multiplier = app.outputs.target_time_multiplier });
             ud.engine.post(e::set_tps{ .tps = app.outputs.target_tps });
             ud.engine.post(e::set_parallel_ticking{ .parallel_ticking = app.outputs.parallel_ticking });
+            ud.engine.post(e::set_tick_backend{ .tick_backend = app.outputs.job_pool ? g::tick_backend::job_pool : g::tick_backend::openmp });
+            ud.engine.post(e::set_tick_workers{ .tick_workers = app.outputs.tick_workers });
         }
 
         ud.engine_tick(app.outputs.engine_has_dedicated_thread);
-        auto snapshot = ud.engine.take_snapshot(); // Take a copy of the latest snapshot.
+        auto const  frame    = ud.engine.take_snapshot_pair(); // Keeps both snapshots alive while we use them.
+        auto const& snapshot = *frame.current;
+        auto const& previous = *frame.previous;
+
+        // These move every frame, ticks or not.
+        app.params.interpolation_alpha = frame.alpha;
+        if(auto const camera = snapshot.find(snapshot.camera_object_id); camera)
+        {
+            auto const was = previous.find(snapshot.camera_object_id);
+            app.params.camera.t = g::lerp(was ? was->t : camera->t, camera->t, frame.alpha);
+        }
 
         // Early return if nothing changed.
         if(snapshot.id == ud.last_snapshot_tick) return g::context::loop_message::do_continue;
@@ -91,26 +159,29 @@ int main()
             .max_tps          = 100'000.f,
             .ticks            = snapshot.id - ud.last_snapshot_tick,
             .parallel_ticking = snapshot.engine_config.parallel_ticking,
+            .job_pool         = snapshot.engine_config.tick_backend == g::tick_backend::job_pool,
+            .tick_workers     = snapshot.engine_config.tick_workers,
 
             .has_own_thread = ud.ticking,
         };
-        ud.meshes             = ghuva::move(snapshot.meshes); // It's fine to steal, the snapshot is a copy.
-        app.params.meshes     = ud.meshes.data();
-        app.params.mesh_count = ud.meshes.size();
-
-        ud.rendered_objs.clear();
-        ud.rendered_objs.reserve(snapshot.objects.size()); // TODO: Guesstimation.
-        for(auto const& obj : snapshot.objects)
+        app.params.meshes_reset = false;
+        if(snapshot.meshes_changed_at != ud.meshes_changed_at)
         {
-            if(obj.draw && obj.mesh_id != 0)
-                ud.rendered_objs.push_back({ .mesh_id = obj.mesh_id, .t = obj.t, .mesh_index = 0 /*dummy*/});
-
-            // Update camera transform if this is the camera object.
-            if(obj.id == snapshot.camera_object_id)
-                app.params.camera.t = obj.t;
+            app.params.meshes_reset = snapshot.meshes_replaced_at > ud.meshes_changed_at; // Loaded since.
+            ud.meshes               = snapshot.meshes;
+            ud.meshes_changed_at    = snapshot.meshes_changed_at;
         }
-        app.params.objects      = ud.rendered_objs.data();
-        app.params.object_count = ud.rendered_objs.size();
+        app.params.meshes            = ud.meshes.data();
+        app.params.mesh_count        = ud.meshes.size();
+        app.params.meshes_generation = ud.meshes_changed_at;
+
+        ud.sync_objects(frame);
+        app.params.objects            = ud.changed_objs.data();
+        app.params.object_count       = ud.changed_objs.size();
+        app.params.deleted_objects    = ud.deleted_objs.data();
+        app.params.deleted_count      = ud.deleted_objs.size();
+        app.params.objects_reset      = ud.objs_reset;
+        app.params.objects_generation = snapshot.id;
 
         ud.last_snapshot_tick = snapshot.id;
 
@@ -120,6 +191,84 @@ int main()
 
     ud.exit = true; // So the engine thread also stops.
 
+    if(recorder)
+    {
+        if(ud.engine_thread.joinable()) ud.engine_thread.join(); // The log ends where the engine did.
+        auto const ok = recorder->stop();
+        fmt::print("[main] Recorded {} events, skipped {}{}\n", recorder->recorded(), recorder->skipped(), ok ? "" : ", failed writing the log");
+    }
+
+    if(auto const path = arg("--perf-history"); path) dump_perf_history(ud.engine, *path);
+    if(trace_path) write_trace(*trace_path);
+
+    return 0;
+}
+
+auto start_trace() -> void
+{
+    if(!g::trace::compiled_in) { fmt::print("[main] Built without the trace option, --trace won't record anything\n"); return; }
+
+    g::trace::set_thread_name("main");
+    g::trace::start();
+}
+
+auto write_trace(std::string const& path) -> void
+{
+    if(!g::trace::compiled_in) return;
+
+    g::trace::stop();
+    if(g::trace::write_json(path)) fmt::print("[main] Wrote trace to {}\n", path);
+    else                           fmt::print("[main] Couldn't write trace to {}\n", path);
+}
+
+auto dump_perf_history(userdata::engine_t const& engine, std::string const& path) -> void
+{
+    auto const history = engine.perf_history();
+    for(auto const& phase : g::perf_phases)
+    {
+        auto const p = g::percentiles(history, phase.seconds);
+        fmt::print("[main] {:>16}: p50 {:.6f}s p95 {:.6f}s p99 {:.6f}s max {:.6f}s\n", phase.name, p.p50, p.p95, p.p99, p.max);
+    }
+
+    auto* const out = std::fopen(path.c_str(), "w");
+    auto const ok   = out && (path.ends_with(".json") ? g::write_perf_json(out, history) : g::write_perf_csv(out, history));
+    if(out) std::fclose(out);
+    fmt::print("[main] {} the perf of the last {} ticks to {}\n", ok ? "Wrote" : "Failed writing", history.size(), path);
+}
+
+auto replay(std::string const& log_path, std::optional<std::string> const& perf_path) -> int
+{
+    auto ud = ::userdata{};
+    ud.engine_load_scene();
+
+    std::FILE* perf = nullptr;
+    if(perf_path)
+    {
+        perf = std::fopen(perf_path->c_str(), "w");
+        if(!perf) { fmt::print("[main.replay] Couldn't open {}\n", *perf_path); return 1; }
+        fmt::print(perf, "tick,checksum,objects,objects_changed,fixed_tick,commit,copy_objects,engine_events,"
+                         "sort_messages,load_snapshot,delete_objects,register_objects,register_meshes,object_ticks\n");
+    }
+
+    // Every tick's checksum folded into one, equal for two runs only if every tick was.
+    auto run_checksum = g::fnv1a_seed;
+    auto stopwatch    = g::chrono::stopwatch();
+    auto const result = g::replay(ud.engine, log_path, [&](auto const& s){
+        auto const checksum = s.checksum();
+        run_checksum = g::fnv1a(std::span<u64 const>(&checksum, 1), run_checksum);
+        if(!perf) return;
+
+        auto const& p = s.engine_perf;
+        fmt::print(perf, "{},{:016x},{},{},{},{},{},{},{},{},{},{},{},{}\n",
+            s.id, checksum, s.objects.size(), p.objects_changed, p.fixed_tick, p.commit, p.copy_objects, p.engine_events,
+            p.sort_messages, p.load_snapshot, p.delete_objects, p.register_objects, p.register_meshes, p.object_ticks);
+    });
+    auto const seconds = stopwatch.click().last_segment();
+    if(perf) std::fclose(perf);
+
+    if(!result.ok) { fmt::print("[main.replay] Couldn't replay {} (stopped at tick {})\n", log_path, result.ticks); return 1; }
+    fmt::print("[main.replay] {} ticks in {:.3f}s, {} events fed, {} skipped while recording\n", result.ticks, seconds, result.events, result.skipped);
+    fmt::print("[main.replay] Checksum {:016x}\n", run_checksum);
     return 0;
 }
 
@@ -174,8 +323,22 @@ auto userdata::engine_load_scene() -> void
     for(auto i = 0_u64; i < 10; ++i)
         engine.post(engine_t::register_mesh{ ghuva::meshes::pyramid });
 
+    // All the pyramids just spin around, so they get ticked together instead of one by one.
+    // A system per axis, so each loop always adds to the same component and vectorizes.
+    auto const spin_around = [](u64 axis){
+        return [axis](auto& objects, f32 dt, auto const&, auto&){
+            for(auto i = 0_u64; i < objects.size(); ++i) objects.transforms[i].rot[axis] += dt;
+        };
+    };
+    auto const spin_systems = std::array{
+        engine.add_system("Pyramid spinner x", spin_around(0)),
+        engine.add_system("Pyramid spinner y", spin_around(1)),
+        engine.add_system("Pyramid spinner z", spin_around(2)),
+    };
+    fmt::print("[main.load_scene] Registered systems Pyramid spinner x, y and z {{ .system_ids = {}, {}, {} }}\n", spin_systems[0], spin_systems[1], spin_systems[2]);
+
     // Our pyramid loader will wait for the (original) mesh to be registered to get it's id.
-    auto const ew_post_id = engine.post(engine_t::register_object{ g::objects::make_ew<engine_t>(pyramid_mesh_post_id, [](
+    auto const ew_post_id = engine.post(engine_t::register_object{ g::objects::make_ew<engine_t>(pyramid_mesh_post_id, [spin_systems](
         auto const& _e, auto, auto const&, auto& engine
     ){
         // Due to EW checking all event types we need to tell the compiler exactly what kind of event this is.
@@ -185,35 +348,32 @@ auto userdata::engine_load_scene() -> void
         auto const& e = _e * g::cvt::rc<engine_t::e_register_mesh const&>;
         auto const mesh_id = e.body.mesh.id;
 
-        engine.post(engine_t::register_object{ .object = {{
-            .name = "Pyramid loader",
-            .on_tick = [
-                mesh_id,
-                gen   = std::default_random_engine{},
-                xposdist  = std::uniform_real_distribution<f32>(-8.0, 8.0),
-                yposdist  = std::uniform_real_distribution<f32>(-8.0, 8.0),
-                zposdist  = std::uniform_real_distribution<f32>(1.0, 9.0),
-                rotdist   = std::uniform_real_distribution<f32>(-3.1415, 3.1415),
-                remaining = 16'000_u64
-            ](auto&, auto, auto const& snapshot, auto& engine) mutable
-            {
-                if(remaining <= 0) return;
+        // Then registers all the pyramids, a third per axis.
+        auto gen      = std::default_random_engine{};
+        auto xposdist = std::uniform_real_distribution<f32>(-8.0, 8.0);
+        auto yposdist = std::uniform_real_distribution<f32>(-8.0, 8.0);
+        auto zposdist = std::uniform_real_distribution<f32>(1.0, 9.0);
+        auto rotdist  = std::uniform_real_distribution<f32>(-3.1415, 3.1415);
 
-                engine.post(engine_t::register_object{ .object{{
+        constexpr auto count = 16'000_u64;
+        for(auto axis = 0_u64; axis < spin_systems.size(); ++axis)
+        {
+            auto transforms = std::vector<g::transform>((axis + 1) * count / spin_systems.size() - axis * count / spin_systems.size());
+            for(auto& t : transforms) t = {
+                .pos   = {xposdist(gen),  yposdist(gen),  zposdist(gen)},
+                .rot   = {rotdist(gen),   rotdist(gen),   rotdist(gen)},
+                .scale = {0.1f,           0.1f,           0.1f},
+            };
+
+            engine.post(engine_t::register_objects{
+                .prototype = {{
                     .name = "Pyramid",
-                    .t = {
-                        .pos   = {xposdist(gen),  yposdist(gen),  zposdist(gen)},
-                        .rot   = {rotdist(gen),   rotdist(gen),   rotdist(gen)},
-                        .scale = {0.1f,           0.1f,           0.1f},
-                    },
-                    .on_tick = [remaining](auto& self, auto dt, auto const&, auto&) { self.t.rot[remaining % 3] += dt; },
                     .mesh_id = mesh_id,
-                }}});
-                fmt::print("[ghuva::engine/t{}][main.load_scene.pyramid_loader] Requested engine to register Pyramid\n", snapshot.id);
-
-                --remaining;
-            }
-        }}});
+                    .system = spin_systems[axis],
+                }},
+                .transforms = ghuva::move(transforms),
+            });
+        }
     })});
     fmt::print("[main.load_scene] Requested engine to register EW for {{ .event_id = {} }}\n", ew_post_id);
 }
@@ -242,14 +402,64 @@ auto userdata::engine_tick(bool dedicated_thread) -> void
     else if(wait_exit)       { fmt::print("[main] engine_thread is dying, waiting to take over ticking.\n"); }
 }
 
+// Only looks at the objects that changed since last_snapshot_tick, unless that was
+// too long ago for the engine to still remember, then app gets all of them again.
+auto userdata::sync_objects(engine_t::snapshot_pair const& frame) -> void
+{
+    auto const& snapshot = *frame.current;
+    auto const& previous = *frame.previous;
+
+    changed_objs.clear();
+    deleted_objs.clear();
+    changed_index.clear();
+    auto const update = [&](g::object_change const& c){
+        if(!c.draw || c.mesh_id == 0) return deleted_objs.push_back(c.id);
+
+        changed_index[c.id] = changed_objs.size();
+        changed_objs.push_back({ .id = c.id, .mesh_id = c.mesh_id, .t = c.t, .previous_t = c.t });
+    };
+
+    auto const delta = engine.delta_between(last_snapshot_tick, snapshot.id);
+    objs_reset = !delta;
+    if(delta)
+    {
+        deleted_objs.insert(deleted_objs.end(), delta->deleted.begin(), delta->deleted.end());
+        for(auto const& c : delta->changed) update(c);
+    }
+    else
+    {
+        auto const ids        = snapshot.objects.ids();
+        auto const transforms = snapshot.objects.transforms();
+        auto const mesh_ids   = snapshot.objects.mesh_ids();
+        auto const flags      = snapshot.objects.flags();
+        for(auto i = 0_u64; i < snapshot.objects.size(); ++i)
+            if(flags[i].draw && mesh_ids[i] != 0)
+                update({ .id = ids[i], .what = 0, .draw = true, .mesh_id = mesh_ids[i], .t = transforms[i] });
+    }
+
+    // The ones that moved during the last tick get to blend in from where they were,
+    // everything else app takes as done moving.
+    for(auto const& c : snapshot.delta->changed)
+    {
+        if(!(c.what & g::object_change::transform_changed) || (c.what & g::object_change::created)) continue;
+
+        auto const it  = changed_index.find(c.id);
+        auto const was = previous.find(c.id);
+        if(it == changed_index.end() || !was) continue;
+
+        changed_objs[it->second].previous_t = was->t;
+    }
+}
+
 auto userdata::engine_thread_start_ticking() -> void
 {
     exit = false;
     ticking = true;
     engine_thread = std::jthread{ [this]() {
         fmt::print("[engine_thread] Starting\n");
-        // TODO: sleep between ticks.
-        while(!this->exit) engine.tick(this->engine_stopwatch.click().last_segment());
+        if(g::trace::recording()) g::trace::set_thread_name("engine");
+        engine.run([this]{ return !this->exit; });
+        this->engine_stopwatch.click(); // Whoever ticks next only owes the time since we stopped.
         fmt::print("[engine_thread] Exiting\n");
         this->ticking = false;
     }};
@@ -0,0 +1,124 @@
+// Runs a world where objects move, flip their draw flag, swap meshes, come and go, and checks
+// that engine::delta_between() takes the objects of any snapshot still in the history to those
+// of a later one, and gives up (nullopt) on anything further back or backwards.
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "ghuva/engine.hpp"
+
+using namespace ghuva::aliases;
+namespace g = ghuva;
+
+namespace
+{
+    using engine_t = g::engine< g::impl::type_list<>, g::impl::type_list<> >;
+
+    // The hot state of each object as deltas see it, by id.
+    struct hot
+    {
+        bool draw;
+        u64  mesh_id;
+        g::transform t;
+
+        auto operator==(hot const& o) const -> bool { return draw == o.draw && mesh_id == o.mesh_id && std::memcmp(&t, &o.t, sizeof(t)) == 0; }
+    };
+    using mirror = std::map<u64, hot>;
+
+    auto mirror_of(engine_t::snapshot const& s) -> mirror
+    {
+        auto m = mirror{};
+        for(auto const o : s.objects) m[o.id] = { .draw = o.draw, .mesh_id = o.mesh_id, .t = o.t };
+        return m;
+    }
+
+    // Applies d to m, false if it doesn't fit (creating what's there, changing or deleting what isn't).
+    auto apply(mirror& m, g::object_delta const& d) -> bool
+    {
+        for(auto const& c : d.changed)
+        {
+            auto const there = m.contains(c.id);
+            if(there == bool(c.what & g::object_change::created)) return false;
+            m[c.id] = { .draw = c.draw, .mesh_id = c.mesh_id, .t = c.t };
+        }
+        for(auto const id : d.deleted) if(m.erase(id) != 1) return false;
+        return true;
+    }
+
+    // Returns the system that moves things.
+    auto setup(engine_t& engine) -> u64
+    {
+        auto const drifter = engine.add_system("Drifter", [](auto& objects, f32 dt, auto const&, auto&){
+            for(auto i = 0_u64; i < objects.size(); ++i) objects.transforms[i].pos.x += dt;
+        });
+        engine.post(engine_t::register_objects{ .prototype = {{ .name = "Drifting", .mesh_id = 1, .system = drifter }}, .count = 100 });
+        engine.post(engine_t::register_objects{ .prototype = {{ .name = "Still", .mesh_id = 1 }}, .count = 100 });
+        engine.post(engine_t::register_objects{ .prototype = {{
+            .name = "Fidget",
+            .on_tick = [](auto& self, auto, auto const& snapshot, auto&){
+                if((snapshot.id + self.id) % 3 == 0) self.draw = !self.draw;
+                if((snapshot.id + self.id) % 5 == 0) self.mesh_id = self.mesh_id == 1 ? 2 : 1;
+            },
+            .mesh_id = 1,
+        }}, .count = 100 });
+        return drifter;
+    }
+}
+
+int main()
+{
+    static engine_t engine;
+    auto const drifter = setup(engine);
+
+    // Every tick a few objects show up (and start moving) and a few go, some of them the ones that just showed up.
+    auto snapshots = std::vector<engine_t::snapshot_handle>{};
+    for(auto i = 0_u64; i < 40; ++i)
+    {
+        engine.step();
+        snapshots.push_back(engine.take_snapshot());
+
+        auto const ids = snapshots.back()->objects.ids();
+        engine.post(engine_t::register_objects{ .prototype = {{ .name = "Mayfly", .mesh_id = 2, .system = drifter }}, .count = 4 });
+        for(auto j = 0_u64; j < 3; ++j) engine.post(engine_t::delete_object{ .id = ids[(i * 7 + j * 31) % ids.size()], .success = false });
+        engine.post(engine_t::delete_object{ .id = ids.back(), .success = false });
+    }
+
+    auto const& last = *snapshots.back();
+    auto failed = false;
+    auto folded = 0_u64;
+    for(auto const& from : snapshots)
+    {
+        auto const d = engine.delta_between(from->id, last.id);
+        if(!d) continue;
+        ++folded;
+
+        auto m = mirror_of(*from);
+        // Folded ones come in id order, each object once.
+        auto const by_id = std::adjacent_find(d->changed.begin(), d->changed.end(), [](auto const& a, auto const& b){ return a.id >= b.id; }) == d->changed.end();
+        if(d->from != from->id || d->to != last.id || !apply(m, *d) || m != mirror_of(last) || (last.id - from->id > 1 && !by_id))
+        {
+            fmt::print("[test] Delta from {} to {} doesn't add up ({} changed, {} deleted)\n", from->id, last.id, d->changed.size(), d->deleted.size());
+            failed = true;
+        }
+    }
+
+    // At least a few ticks back have to be there, but not all the way back.
+    if(folded < 4 || engine.delta_between(snapshots.front()->id, last.id))
+    {
+        fmt::print("[test] Expected a few deltas but not all {}, got {}\n", snapshots.size(), folded);
+        failed = true;
+    }
+    if(engine.delta_between(last.id, snapshots.front()->id) || !engine.delta_between(last.id, last.id) || !engine.delta_between(last.id, last.id)->changed.empty())
+    {
+        fmt::print("[test] Backwards or empty deltas aren't right\n");
+        failed = true;
+    }
+
+    if(failed) return 1;
+    fmt::print("[test] {} deltas up to tick {} add up\n", folded, last.id);
+    return 0;
+}
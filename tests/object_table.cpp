@@ -0,0 +1,188 @@
+// Throws random inserts, appends, erases and regroups at an object_table, checking after each
+// one that every object is where its id says, in the group it asked for, and that the groups
+// still tile the table. Every so often a copy left behind catches up to it, with and without
+// deltas, and has to end up identical.
+#include <fmt/core.h>
+
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ghuva/engine.hpp"
+
+using namespace ghuva::aliases;
+namespace g = ghuva;
+
+namespace
+{
+    using engine_t = g::engine< g::impl::type_list<>, g::impl::type_list<> >;
+    using table_t  = decltype(engine_t::snapshot::objects);
+
+    struct expected_t
+    {
+        u64 group;
+        f32 tag; // In t.pos.x, unique per object.
+    };
+
+    auto consistent(table_t const& table, std::map<u64, expected_t> const& expected, std::vector<u64> const& dead) -> bool
+    {
+        if(table.size() != expected.size() || table.transforms().size() != table.size()
+        || table.mesh_ids().size() != table.size() || table.flags().size() != table.size()) return false;
+
+        for(auto grp = 0_u64; grp < table.group_count(); ++grp)
+            if(table.group_begin(grp) > table.group_end(grp)) return false;
+        if(table.group_end(table.group_count() - 1) != table.size()) return false;
+
+        for(auto i = 0_u64; i < table.size(); ++i)
+        {
+            auto const id = table.ids()[i];
+            auto const it = expected.find(id);
+            if(it == expected.end() || table.index_of(id) != i) return false;
+            if(table.group_of(i) != it->second.group || table.transforms()[i].pos.x != it->second.tag) return false;
+        }
+        for(auto const id : dead) if(table.find(id)) return false;
+        return true;
+    }
+
+    auto identical(table_t const& a, table_t const& b) -> bool
+    {
+        if(a.size() != b.size() || a.group_count() != b.group_count()) return false;
+        for(auto grp = 0_u64; grp < a.group_count(); ++grp) if(a.group_end(grp) != b.group_end(grp)) return false;
+        for(auto i = 0_u64; i < a.size(); ++i)
+        {
+            auto const x = a[i];
+            auto const y = b[i];
+            if(x.id != y.id || b.index_of(x.id) != i || x.touched_at != y.touched_at || x.name != y.name
+            || x.mesh_id != y.mesh_id || x.draw != y.draw || x.tick != y.tick
+            || std::memcmp(&x.t, &y.t, sizeof(x.t)) != 0) return false;
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    auto rng      = std::mt19937_64{ 4321 };
+    auto table    = table_t{};
+    auto expected = std::map<u64, expected_t>{};
+    auto dead     = std::vector<u64>{};
+    auto next_tag = 0.f;
+    auto tick     = 1_u64;
+    auto failed   = false;
+    auto fail     = [&](auto const& what, u64 round){ fmt::print("[test] {} at round {}\n", what, round); failed = true; };
+
+    auto make = [&](u64 system){
+        auto o = table_t::object_t({ .name = "Object", .t = { .pos = { next_tag++, 0, 0 } }, .mesh_id = 1, .system = system });
+        o.touched_at = tick;
+        return o;
+    };
+
+    for(auto round = 0_u64; round < 3000 && !failed; ++round)
+    {
+        auto const op = rng() % 12;
+        // Some ask for groups that aren't there (yet), those go in group 0.
+        auto const system = rng() % (table.group_count() + 1);
+        auto const group  = system < table.group_count() ? system : 0;
+
+        if(op < 4 || expected.empty())
+        {
+            auto const tag = next_tag;
+            expected[table.insert(make(system))] = { .group = group, .tag = tag };
+        }
+        else if(op < 6)
+        {
+            // Appended copies all share the prototype's tag, so tell them apart afterwards.
+            auto const count = 1 + rng() % 8;
+            auto const first = table.append(count, make(system));
+            for(auto i = 0_u64; i < count; ++i)
+            {
+                table.transforms()[table.index_of(first + i)].pos.x = next_tag;
+                expected[first + i] = { .group = group, .tag = next_tag++ };
+            }
+        }
+        else if(op < 9)
+        {
+            auto it = expected.begin();
+            std::advance(it, rng() % expected.size());
+            if(!table.erase(it->first) || table.erase(it->first)) fail("Erase went wrong", round);
+            dead.push_back(it->first);
+            expected.erase(it);
+        }
+        else if(op < 10)
+        {
+            if(table.group_count() < 6) table.set_group_count(table.group_count() + 1);
+        }
+        else
+        {
+            // Groups get shuffled into (maybe) more of them. Each new group is the old ones that map
+            // to it, in order, with their objects in the order they were.
+            auto const count = table.group_count() + (table.group_count() < 6 ? rng() % 2 : 0);
+            auto map = std::vector<u64>(table.group_count());
+            for(auto& to : map) to = rng() % count;
+
+            auto want = std::vector< std::vector<u64> >(count);
+            for(auto grp = 0_u64; grp < table.group_count(); ++grp)
+                for(auto i = table.group_begin(grp); i < table.group_end(grp); ++i) want[map[grp]].push_back(table.ids()[i]);
+
+            table.regroup(map, count);
+            for(auto& [id, e] : expected) e.group = map[e.group];
+            for(auto grp = 0_u64; grp < count; ++grp)
+            {
+                auto const ids = table.ids().subspan(table.group_begin(grp), table.group_end(grp) - table.group_begin(grp));
+                if(!std::equal(ids.begin(), ids.end(), want[grp].begin(), want[grp].end())) fail("Regroup shuffled a group", round);
+            }
+        }
+        if(!consistent(table, expected, dead)) fail("Table out of sync", round);
+
+        if(round % 50 != 0 || failed) continue;
+
+        // Two ticks worth of changes to the same objects, once to a few of them and once to most.
+        for(auto const share : { 50_u64, 2_u64 })
+        {
+            auto const since  = tick;
+            auto behind       = table;
+            auto deltas       = std::vector<g::object_delta>{};
+            for(auto step = 0; step < 2; ++step)
+            {
+                auto const before = table;
+                ++tick;
+                auto& delta = deltas.emplace_back(g::object_delta{ .from = tick - 1, .to = tick });
+                for(auto i = 0_u64; i < table.size(); ++i)
+                {
+                    if(rng() % share != 0) continue;
+                    auto o = table[i];
+                    o.t.pos.y += 1.f;
+                    o.draw = !o.draw;
+                    if(rng() % 2 == 0) continue; // Hot only.
+                    o.touched_at = tick;
+                    o.name = fmt::format("Touched at {}", tick);
+                    delta.ticked.push_back(o.id);
+                }
+                table.diff(before, 0, table.size(), delta.changed);
+            }
+
+            auto const pointers = std::vector<g::object_delta const*>{ &deltas[0], &deltas[1] };
+            behind.catch_up(table, [&](u64 touched_at){ return touched_at > since; }, std::span(pointers));
+            if(!identical(behind, table)) fail(share == 2 ? "Dense catch_up with deltas diverged" : "Sparse catch_up with deltas diverged", round);
+        }
+
+        // Objects that came and went in between, no deltas to go on.
+        auto behind = table;
+        auto const since = tick++;
+        auto const tag  = next_tag;
+        auto const into = rng() % table.group_count();
+        expected[table.insert(make(into))] = { .group = into, .tag = tag };
+        auto const gone = table.ids()[table.size() / 2];
+        table.erase(gone);
+        expected.erase(gone);
+        dead.push_back(gone);
+        behind.catch_up(table, [&](u64 touched_at){ return touched_at > since; });
+        if(!identical(behind, table) || !consistent(behind, expected, dead)) fail("catch_up across a layout change diverged", round);
+    }
+
+    if(failed) return 1;
+    fmt::print("[test] {} objects in {} groups, {} ids gone, all in sync\n", table.size(), table.group_count(), dead.size());
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Throws random inserts, appends, erases and swaps at a slot_map, checking it against a plain
+// map of key -> value after each one, and that catch_up() and restore() keep every key intact.
+#include <fmt/core.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "ghuva/utils/slot_map.hpp"
+
+using namespace ghuva::aliases;
+namespace g = ghuva;
+
+namespace
+{
+    using map_t = g::slot_map<u64>;
+
+    // Every live key finds its value at the index it says, and nothing else is found.
+    auto matches(map_t const& m, std::map<u64, u64> const& expected, std::vector<u64> const& dead) -> bool
+    {
+        if(m.size() != expected.size()) return false;
+        for(auto const& [key, value] : expected)
+        {
+            auto const index = m.index_of(key);
+            if(index == map_t::npos || m.key_at(index) != key || m[index] != value || m.find(key) != &m[index]) return false;
+        }
+        for(auto const key : dead) if(m.contains(key)) return false;
+        return !m.contains(0);
+    }
+
+    auto restored(map_t const& m) -> map_t
+    {
+        auto copy = map_t{};
+        if(!copy.restore(m.raw_value_slots(), m.raw_slots(), m.raw_free_head())) return copy;
+        for(auto i = 0_u64; i < m.size(); ++i) copy[i] = m[i];
+        return copy;
+    }
+}
+
+int main()
+{
+    auto rng      = std::mt19937_64{ 1234 };
+    auto m        = map_t{};
+    auto behind   = map_t{}; // Caught up every few rounds.
+    auto expected = std::map<u64, u64>{};
+    auto dead     = std::vector<u64>{};
+    auto failed   = false;
+
+    for(auto round = 0_u64; round < 10'000 && !failed; ++round)
+    {
+        auto const op = rng() % 10;
+        if(op < 4 || expected.empty())
+        {
+            auto const value = rng();
+            expected[m.insert(value)] = value;
+        }
+        else if(op < 5)
+        {
+            auto const count = 1 + rng() % 5;
+            auto const first = m.append(count, round);
+            for(auto i = 0_u64; i < count; ++i) expected[first + i] = round;
+        }
+        else if(op < 8)
+        {
+            auto it = expected.begin();
+            std::advance(it, rng() % expected.size());
+            failed |= !m.erase(it->first) || m.erase(it->first); // Twice, the second one is stale.
+            dead.push_back(it->first);
+            expected.erase(it);
+        }
+        else if(op < 9)
+        {
+            m.swap(rng() % m.size(), rng() % m.size());
+        }
+        else
+        {
+            auto const index = rng() % m.size(); // Same key, new value.
+            m[index] = round;
+            expected[m.key_at(index)] = round;
+        }
+        failed |= !matches(m, expected, dead);
+
+        if(round % 97 == 0)
+        {
+            // Catching up only copies what isn't there already, and only what changed() lets through
+            // when the key is the same. Letting everything through has to end up equal.
+            behind.catch_up(m, [](u64){ return true; });
+            failed |= !matches(behind, expected, dead);
+            failed |= !matches(restored(m), expected, dead);
+        }
+    }
+    if(failed) { fmt::print("[test] slot_map went out of sync with the map\n"); return 1; }
+
+    // The keyed catch_up only copies the values of the keys given.
+    auto copy = m;
+    for(auto i = 0_u64; i < copy.size(); ++i) copy[i] = 0;
+    auto const some = std::vector<u64>{ m.key_at(0), m.key_at(m.size() / 2), dead.front() };
+    auto const copied = copy.catch_up(m, some, [](u64){ return true; });
+    if(copied != 2 || copy[0] != m[0] || copy[m.size() / 2] != m[m.size() / 2] || (m.size() > 2 && copy[1] != 0))
+    {
+        fmt::print("[test] Keyed catch_up copied {} values, expected 2\n", copied);
+        return 1;
+    }
+
+    // Free chains that don't add up get turned down: one going round in circles, one that stops
+    // short and one with a live slot on it.
+    auto const value_slots = std::vector(m.raw_value_slots().begin(), m.raw_value_slots().end());
+    auto const slots       = std::vector(m.raw_slots().begin(), m.raw_slots().end());
+    auto const head        = m.raw_free_head();
+    if(head == map_t::no_slot || slots[head].index == map_t::no_slot) { fmt::print("[test] Expected a few free slots\n"); return 1; }
+    auto circle = slots;
+    circle[head].index = head;
+    auto scratch = map_t{};
+    if(scratch.restore(value_slots, circle, head) || scratch.restore(value_slots, slots, slots[head].index) || scratch.restore(value_slots, slots, value_slots[0]))
+    {
+        fmt::print("[test] Restored a broken free chain\n");
+        return 1;
+    }
+
+    fmt::print("[test] {} values, {} keys gone, all in sync\n", m.size(), dead.size());
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Saves a world, loads it into a fresh engine and checks it came back the same, then checks
+// that truncated files and ones with the wrong magic or version get turned down untouched.
+#include <fmt/core.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ghuva/meshes/pyramid.hpp"
+#include "ghuva/utils/hash.hpp"
+#include "ghuva/engine.hpp"
+
+using namespace ghuva::aliases;
+namespace g = ghuva;
+
+namespace
+{
+    using engine_t = g::engine< g::impl::type_list<>, g::impl::type_list<> >;
+
+    // Same as snapshot::checksum() minus the tick and game time, which move on by themselves,
+    // plus the names.
+    auto world_checksum(engine_t::snapshot const& s) -> u64
+    {
+        auto hash = g::fnv1a(std::span<u64 const>(&s.camera_object_id, 1));
+        hash = g::fnv1a(std::span<u64 const>(&s.engine_config.last_mesh_id, 1), hash);
+        for(auto const& m : s.meshes) hash = g::fnv1a(std::span<u64 const>(&m.id, 1), hash);
+        hash = g::fnv1a(s.objects.ids(),        hash);
+        hash = g::fnv1a(s.objects.transforms(), hash);
+        hash = g::fnv1a(s.objects.mesh_ids(),   hash);
+        hash = g::fnv1a(s.objects.flags(),      hash);
+        for(auto const o : s.objects) hash = g::fnv1a(std::span<char const>(o.name), hash);
+        return hash;
+    }
+
+    auto add_systems(engine_t& engine) -> u64
+    {
+        return engine.add_system("Spinner", [](auto& objects, f32 dt, auto const&, auto&){
+            for(auto i = 0_u64; i < objects.size(); ++i) objects.transforms[i].rot.y += dt;
+        });
+    }
+
+    // Loads path into engine, true if it took.
+    auto load(engine_t& engine, std::string const& path) -> bool
+    {
+        engine.post(engine_t::load_snapshot{ .path = path, .success = false });
+        engine.step();
+        auto success = false;
+        engine.take_snapshot()->template on_post<engine_t::e_load_snapshot>([&](auto const& e){ success = e.body.success; });
+        return success;
+    }
+
+    auto read_file(std::string const& path) -> std::vector<char>
+    {
+        auto bytes = std::vector<char>{};
+        if(auto* f = std::fopen(path.c_str(), "rb"))
+        {
+            auto buffer = std::vector<char>(1 << 16);
+            for(auto n = 0_u64; (n = std::fread(buffer.data(), 1, buffer.size(), f)) > 0;) bytes.insert(bytes.end(), buffer.begin(), buffer.begin() + n * g::cvt::to<i64>);
+            std::fclose(f);
+        }
+        return bytes;
+    }
+
+    auto write_file(std::string const& path, std::span<char const> bytes) -> void
+    {
+        if(auto* f = std::fopen(path.c_str(), "wb"))
+        {
+            std::fwrite(bytes.data(), 1, bytes.size(), f);
+            std::fclose(f);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    auto const path = std::string(argc > 1 ? argv[1] : "test-snapshot.bin");
+    auto const bad  = path + ".bad";
+
+    // Objects in and out of a system, a few deleted so the slots have holes, and a camera.
+    static engine_t saved;
+    auto const spinner = add_systems(saved);
+    saved.post(engine_t::register_mesh{ g::meshes::pyramid });
+    saved.post(engine_t::register_mesh{ g::meshes::pyramid });
+    saved.post(engine_t::register_objects{ .prototype = {{ .name = "Spinning", .mesh_id = 1, .system = spinner }}, .count = 3000 });
+    saved.post(engine_t::register_objects{ .prototype = {{ .name = "Still", .mesh_id = 2 }}, .count = 1000 });
+    saved.step();
+    auto const ids = saved.take_snapshot()->objects.ids();
+    for(auto i = 0_u64; i < ids.size(); i += 37) saved.post(engine_t::delete_object{ .id = ids[i], .success = false });
+    saved.post(engine_t::set_camera{ .object_id = ids[1] });
+    for(auto i = 0; i < 10; ++i) saved.step();
+
+    auto const expected = saved.take_snapshot();
+    if(!engine_t::save_snapshot(*expected, path)) { fmt::print("[test] Couldn't write {}\n", path); return 1; }
+
+    static engine_t loaded;
+    add_systems(loaded);
+    loaded.post(engine_t::register_object{ .object = {{ .name = "Already here" }} });
+    loaded.step();
+    auto const before = world_checksum(*loaded.take_snapshot());
+
+    // Anything short of the whole file, or with the wrong magic or version, leaves the world as it was.
+    auto const bytes = read_file(path);
+    auto rejected = true;
+    for(auto n = 0_u64; n < bytes.size(); n += 1 + bytes.size() / 200)
+    {
+        write_file(bad, std::span(bytes).first(n));
+        rejected &= !load(loaded, bad);
+    }
+    write_file(bad, std::span(bytes).first(bytes.size() - 1));
+    rejected &= !load(loaded, bad);
+    for(auto const at : { 0_u64, 8_u64 }) // The magic, then the version.
+    {
+        auto broken = bytes;
+        broken[at] ^= 1;
+        write_file(bad, broken);
+        rejected &= !load(loaded, bad);
+    }
+    std::remove(bad.c_str());
+    if(!rejected || world_checksum(*loaded.take_snapshot()) != before)
+    {
+        fmt::print("[test] A broken file got loaded\n");
+        return 1;
+    }
+
+    // The objects get ticked right after being loaded, so they're a tick ahead of what was saved.
+    // The game time is taken as it was saved.
+    if(!load(loaded, path)) { fmt::print("[test] Couldn't load {}\n", path); return 1; }
+    saved.step();
+    auto const want = world_checksum(*saved.take_snapshot());
+    auto const have = loaded.take_snapshot();
+    auto const got  = world_checksum(*have);
+    fmt::print("[test] Saved {} objects ({} bytes), loaded {}\n", expected->objects.size(), bytes.size(), have->objects.size());
+    if(got != want || have->engine_config.total_time != expected->engine_config.total_time)
+    {
+        fmt::print("[test] Loaded world differs: {:016x} vs {:016x}, {}s vs {}s of game time\n",
+            got, want, have->engine_config.total_time, expected->engine_config.total_time);
+        return 1;
+    }
+
+    fmt::print("[test] Round trip matches, checksum {:016x}\n", got);
+    return 0;
+}